@@ -22,7 +22,13 @@ do_configure() {
 }
 
 do_build() {
+	local _jobs="$XBPS_MAKEJOBS" rval=0
+
 	go_package=${go_package:-$go_import_path}
+	# go has no jobserver client, take the tokens for its jobs here
+	if jobserver_take $((XBPS_MAKEJOBS - 1)); then
+		_jobs=$((1 + ${#_jobserver_tokens}))
+	fi
 	# Build using Go modules if there's a go.mod file
 	if [ "${go_mod_mode}" != "off" ] && [ -f go.mod ]; then
 		if [ -z "${go_mod_mode}" ] && [ -d vendor ]; then
@@ -33,11 +39,13 @@ do_build() {
 			# default behavior.
 			go_mod_mode=
 		fi
-		go install -p "$XBPS_MAKEJOBS" -mod="${go_mod_mode}" -x -tags "${go_build_tags}" -ldflags "${go_ldflags}" ${go_package}
+		go install -p "$_jobs" -mod="${go_mod_mode}" -x -tags "${go_build_tags}" -ldflags "${go_ldflags}" ${go_package} || rval=$?
 	else
 		# Otherwise, build using GOPATH
-		go get -p "$XBPS_MAKEJOBS" -x -tags "${go_build_tags}" -ldflags "${go_ldflags}" ${go_package}
+		go get -p "$_jobs" -x -tags "${go_build_tags}" -ldflags "${go_ldflags}" ${go_package} || rval=$?
 	fi
+	jobserver_return
+	return $rval
 }
 
 do_install() {
@@ -24,7 +24,7 @@ do_build() {
 			stack init ${_stack_args} --force --resolver ${stackage}
 	fi
 
-	STACK_ROOT="$wrksrc/.stack" stack ${_stack_args} ${makejobs} build \
+	STACK_ROOT="$wrksrc/.stack" stack ${_stack_args} -j${XBPS_MAKEJOBS} build \
 		${make_build_args}
 }
 
@@ -4,7 +4,7 @@
 do_build() {
 	: ${make_cmd:=scons}
 
-	${make_cmd} ${makejobs} CC=$CC CXX=$CXX CCFLAGS="$CFLAGS" \
+	${make_cmd} -j${XBPS_MAKEJOBS} CC=$CC CXX=$CXX CCFLAGS="$CFLAGS" \
 		cc=$CC cxx=$CXX ccflags="$CFLAGS" \
 		CXXFLAGS="$CXXFLAGS" LINKFLAGS="$LDFLAGS" \
 		cxxflags="$CXXFLAGS" linkflags="$LDFLAGS" \
@@ -16,7 +16,7 @@ do_install() {
 	: ${make_cmd:=scons}
 	: ${make_install_target:=install}
 
-	${make_cmd} ${makejobs} CC=$CC CXX=$CXX CCFLAGS="$CFLAGS" \
+	${make_cmd} -j${XBPS_MAKEJOBS} CC=$CC CXX=$CXX CCFLAGS="$CFLAGS" \
 		cc=$CC cxx=$CXX ccflags="$CFLAGS" \
 		CXXFLAGS="$CXXFLAGS" LINKFLAGS="$LDFLAGS" \
 		cxxflags="$CXXFLAGS" linkflags="$LDFLAGS" \
@@ -0,0 +1,24 @@
+# Use the jobserver shared by xbps-src instances (XBPS_JOBSERVER) instead of
+# a -j of our own: make>=4.4 and ninja>=1.13 take their job tokens from it,
+# and so do cargo and rustc. Older make fails on a fifo jobserver.
+_makever=$(make --version 2>/dev/null | sed -n '1s/^GNU Make //p')
+$XBPS_CMPVER_CMD "${_makever:-4.4}" 4.4
+if [ $? -ne 255 -a -n "$XBPS_JOBSERVER" -a -z "$disable_parallel_build" ] &&
+	[ -p "$(jobserver_fifo)" ]; then
+	export MAKEFLAGS="-j${XBPS_MAKEJOBS} --jobserver-auth=fifo:$(jobserver_fifo)"
+	export CARGO_MAKEFLAGS="$MAKEFLAGS"
+	# An explicit -j makes make and ninja ignore the jobserver, but older
+	# ninja doesn't know about it and needs the -j. Keep it only for the
+	# build styles running ninja, make would get it too otherwise.
+	_ninjaver=$(ninja --version 2>/dev/null)
+	$XBPS_CMPVER_CMD "${_ninjaver:-1.13.0}" 1.13.0
+	if [ $? -ne 255 ]; then
+		makejobs=
+	else
+		case "$build_style" in
+			cmake|meson) [ "${make_cmd:-ninja}" = ninja ] || makejobs=;;
+			*) makejobs=;;
+		esac
+	fi
+fi
+unset _makever _ninjaver
@@ -0,0 +1 @@
+../build/jobserver.sh
\ No newline at end of file
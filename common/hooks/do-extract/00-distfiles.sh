@@ -1,9 +1,66 @@
 # This hook extracts $distfiles into $XBPS_BUILDDIR if $distfiles and $checksum
 # variables are set.
 
+# Extract the tarball $distfile into $extractdir and verify its sha256
+# $cksum (of its contents if it starts with @) at once: the tarball is
+# decompressed once and passed through tee(1) to both the digest and
+# tar(1). What was extracted is kept only if the sum matches.
+extract_verify() {
+	local distfile="$1" extractdir="$2" cksum="$3"
+	local curfile="${1##*/}" decomp tmpdir digest f
+	local -a rv
+
+	decomp=$(distfile_decompress_cmd "$distfile")
+	msg_normal "$pkgver: extracting and verifying checksum for distfile '$curfile'... "
+	tmpdir=$(mktemp -d "$extractdir/.extract.XXXXXXXX") ||
+		msg_error "$pkgver: failed to create temporary dir in $extractdir.\n"
+	mkfifo $tmpdir.fifo
+	if [ "${cksum:0:1}" = "@" ]; then
+		$XBPS_DIGEST_CMD <($TAR_CMD -x -O -f $tmpdir.fifo) > $tmpdir.sum &
+		digest=$!
+		$decomp < "$distfile" | tee -p $tmpdir.fifo | \
+			$TAR_CMD -x --no-same-permissions --no-same-owner -f - -C "$tmpdir"
+		rv=("${PIPESTATUS[@]:1}")
+		wait $digest
+		echo "@$(cat $tmpdir.sum)" > $tmpdir.sum
+	else
+		$XBPS_DIGEST_CMD $tmpdir.fifo > $tmpdir.sum &
+		digest=$!
+		tee -p $tmpdir.fifo < "$distfile" | $decomp | \
+			$TAR_CMD -x --no-same-permissions --no-same-owner -f - -C "$tmpdir"
+		rv=("${PIPESTATUS[0]}" "${PIPESTATUS[2]}")
+		wait $digest
+	fi
+	if [ "${rv[0]}" -ne 0 -o "${rv[1]}" -ne 0 ]; then
+		rm -rf $tmpdir $tmpdir.fifo $tmpdir.sum
+		echo
+		msg_error "$pkgver: extracting $curfile into $XBPS_BUILDDIR.\n"
+	fi
+	if [ "$(cat $tmpdir.sum)" != "$cksum" ]; then
+		echo
+		msg_red "SHA256 mismatch for '$curfile:'\n$(cat $tmpdir.sum)\n"
+		rm -rf $tmpdir $tmpdir.fifo $tmpdir.sum
+		distfile_purge "$distfile"
+		msg_error "$pkgver: couldn't verify distfiles, exiting...\n"
+	fi
+	rm -f $tmpdir.fifo $tmpdir.sum
+	# move what was extracted in place, merging dirs that already exist
+	find $tmpdir -mindepth 1 -maxdepth 1 -printf '%f\n' | while read -r f; do
+		if [ -e "$extractdir/$f" -o -L "$extractdir/$f" ]; then
+			cp -al --remove-destination "$tmpdir/$f" "$extractdir/"
+		else
+			mv "$tmpdir/$f" "$extractdir/"
+		fi
+	done
+	rm -rf $tmpdir
+	[ "${cksum:0:1}" != "@" ] && distfile_link_sha256 "$distfile" "$curfile" "$cksum"
+	distfile_set_verified $curfile
+	msg_normal_append "OK.\n"
+}
+
 hook() {
 	local srcdir="$XBPS_SRCDISTDIR/$pkgname-$version"
-	local f j curfile found extractdir
+	local f j curfile cursufx cksum decomp rv found extractdir
 	local TAR_CMD
 
 	if [ -z "$distfiles" -a -z "$checksum" ]; then
@@ -47,31 +104,8 @@ hook() {
 			continue
 		fi
 
-		case $curfile in
-		*.tar.lzma)   cursufx="txz";;
-		*.tar.lz)     cursufx="tlz";;
-		*.tlz)        cursufx="tlz";;
-		*.tar.xz)     cursufx="txz";;
-		*.txz)        cursufx="txz";;
-		*.tar.bz2)    cursufx="tbz";;
-		*.tbz)        cursufx="tbz";;
-		*.tar.gz)     cursufx="tgz";;
-		*.tgz)        cursufx="tgz";;
-		*.gz)         cursufx="gz";;
-		*.xz)         cursufx="xz";;
-		*.bz2)        cursufx="bz2";;
-		*.tar)        cursufx="tar";;
-		*.zip)        cursufx="zip";;
-		*.rpm)        cursufx="rpm";;
-		*.patch)      cursufx="txt";;
-		*.diff)       cursufx="txt";;
-		*.txt)        cursufx="txt";;
-		*.sh)         cursufx="txt";;
-		*.7z)	      cursufx="7z";;
-		*.gem)	      cursufx="gem";;
-		*.crate)      cursufx="crate";;
-		*) msg_error "$pkgver: unknown distfile suffix for $curfile.\n";;
-		esac
+		cursufx=$(distfile_suffix $curfile) ||
+			msg_error "$pkgver: unknown distfile suffix for $curfile.\n"
 
 		if [ -n "$create_wrksrc" ]; then
 			extractdir="$wrksrc"
@@ -80,13 +114,31 @@ hook() {
 		fi
 
 		case ${cursufx} in
-		tar|txz|tbz|tlz|tgz|crate)
-			$TAR_CMD -x --no-same-permissions --no-same-owner -f $srcdir/$curfile -C "$extractdir"
-			if [ $? -ne 0 ]; then
+		tar|txz|tbz|tlz|tgz|tzst|crate)
+			cksum=$(distfile_unverified_cksum $curfile)
+			if [ -n "$cksum" ]; then
+				extract_verify $srcdir/$curfile "$extractdir" $cksum
+				continue
+			fi
+			# Decompress with all cores if a parallel decompressor is there,
+			# tar(1) decompresses on a single one.
+			decomp=$(distfile_parallel_decompress_cmd $curfile)
+			if [ -n "$decomp" ]; then
+				$decomp < $srcdir/$curfile | \
+					$TAR_CMD -x --no-same-permissions --no-same-owner -f - -C "$extractdir"
+				rv=("${PIPESTATUS[@]}")
+				# tar(1) may stop reading at the end of the archive
+				[ ${rv[0]} -eq 141 ] && rv[0]=0
+				rv=$((rv[0] + rv[1]))
+			else
+				$TAR_CMD -x --no-same-permissions --no-same-owner -f $srcdir/$curfile -C "$extractdir"
+				rv=$?
+			fi
+			if [ $rv -ne 0 ]; then
 				msg_error "$pkgver: extracting $curfile into $XBPS_BUILDDIR.\n"
 			fi
 			;;
-		gz|bz2|xz)
+		gz|bz2|xz|zst)
 			cp -f $srcdir/$curfile "$extractdir"
 			cd "$extractdir"
 			case ${cursufx} in
@@ -96,6 +148,9 @@ hook() {
 			bz2)
 				bunzip2 -f $curfile
 				;;
+			zst)
+				unzstd -q -f --rm $curfile
+				;;
 			*)
 				unxz -f $curfile
 				;;
@@ -20,124 +20,45 @@ get_cksum() {
 	echo "$cksum"
 }
 
-# Return the checksum of the contents of a tarball
-contents_cksum() {
-	local curfile="$1" cursufx cksum
-
-	case $curfile in
-	*.tar.lzma)   cursufx="txz";;
-	*.tar.lz)     cursufx="tlz";;
-	*.tlz)        cursufx="tlz";;
-	*.tar.xz)     cursufx="txz";;
-	*.txz)        cursufx="txz";;
-	*.tar.bz2)    cursufx="tbz";;
-	*.tbz)        cursufx="tbz";;
-	*.tar.gz)     cursufx="tgz";;
-	*.tgz)        cursufx="tgz";;
-	*.gz)         cursufx="gz";;
-	*.bz2)        cursufx="bz2";;
-	*.tar)        cursufx="tar";;
-	*.zip)        cursufx="zip";;
-	*.rpm)        cursufx="rpm";;
-	*.patch)      cursufx="txt";;
-	*.diff)       cursufx="txt";;
-	*.txt)        cursufx="txt";;
-	*.7z)	      cursufx="7z";;
-	*.gem)	      cursufx="gem";;
-	*.crate)      cursufx="crate";;
-	*) msg_error "$pkgver: unknown distfile suffix for $curfile.\n";;
-	esac
-
-	case ${cursufx} in
-	tar|txz|tbz|tlz|tgz|crate)
-		cksum=$($XBPS_DIGEST_CMD <($TAR_CMD -x -O -f "$curfile"))
-		if [ $? -ne 0 ]; then
-			msg_error "$pkgver: extracting $curfile to pipe.\n"
-		fi
-		;;
-	gz)
-		cksum=$($XBPS_DIGEST_CMD <(gunzip -c "$curfile"))
-		;;
-	bz2)
-		cksum=$($XBPS_DIGEST_CMD <(bunzip2 -c "$curfile"))
-		;;
-	zip)
-		if command -v unzip &>/dev/null; then
-			cksum=$($XBPS_DIGEST_CMD <(unzip -p "$curfile"))
-			if [ $? -ne 0 ]; then
-				msg_error "$pkgver: extracting $curfile to pipe.\n"
-			fi
-		else
-			msg_error "$pkgver: cannot find unzip bin for extraction.\n"
-		fi
-		;;
-	rpm)
-		if command -v rpmextract &>/dev/null; then
-			cksum=$($XBPS_DIGEST_CMD <(rpm2cpio "$curfile" | $TAR_CMD -x -f -))
-			if [ $? -ne 0 ]; then
-				msg_error "$pkgver: extracting $curfile to pipe.\n"
-			fi
-		else
-			msg_error "$pkgver: cannot find rpmextract for extraction.\n"
-		fi
-		;;
-	txt)
-		cksum=$($XBPS_DIGEST_CMD "$curfile")
-		;;
-	7z)
-		if command -v 7z &>/dev/null; then
-			cksum=$($XBPS_DIGEST_CMD <(7z x -o "$curfile"))
-			if [ $? -ne 0 ]; then
-				msg_error "$pkgver: extracting $curfile to pipe.\n"
-			fi
-		else
-			msg_error "$pkgver: cannot find 7z bin for extraction.\n"
-		fi
-		;;
-	gem)
-		cksum=$($XBPS_DIGEST_CMD <($TAR_CMD -x -O -f "$curfile" data.tar.gz | $TAR_CMD -xzO ))
-		;;
-	*)
-		msg_error "$pkgver: cannot guess $curfile extract suffix. ($cursufx)\n"
-		;;
-	esac
-
-	if [ -z "$cksum" ]; then
-		msg_error "$pkgver: cannot find contents checksum for $curfile.\n"
-	fi
-	echo "$cksum"
-}
-
-# Verify the checksum for $curfile stored at $distfile and index $dfcount
+# Verify the checksum for $curfile stored at $distfile and index $dfcount,
+# using the sha256 $filesum if it was computed while fetching. If it has
+# to be read again and is extracted later on, it is left to do-extract.
 verify_cksum() {
-	local curfile="$1" distfile="$2" dfcount="$3" filesum cksum
+	local curfile="$1" distfile="$2" dfcount="$3" filesum="$4" cksum
 
 	cksum=$(get_cksum $curfile $dfcount)
 
+	if [ "$cksum" != "$filesum" ] && distfile_verified_by_extract $curfile; then
+		msg_normal "$pkgver: checksum for distfile '$curfile' is verified while extracting.\n"
+		echo "$cksum $curfile" >> $(distfiles_unverified)
+		return 0
+	fi
+
 	# If the checksum starts with an commercial at (@) it is the contents checksum
 	if [ "${cksum:0:1}" = "@" ]; then
 		cksum=${cksum:1}
 		msg_normal "$pkgver: verifying contents checksum for distfile '$curfile'... "
-		filesum=$(contents_cksum "$curfile")
+		filesum=$(distfile_contents_cksum "$curfile")
 		if [ "${cksum}" != "$filesum" ]; then
 			echo
 			msg_red "SHA256 mismatch for '$curfile:'\n@$filesum\n"
 			errors=$((errors + 1))
+			return 1
 		else
 			msg_normal_append "OK.\n"
 		fi
 	else
 		msg_normal "$pkgver: verifying checksum for distfile '$curfile'... "
-		filesum=$(${XBPS_DIGEST_CMD} "$distfile")
+		if [ "$cksum" != "$filesum" ]; then
+			filesum=$(${XBPS_DIGEST_CMD} "$distfile")
+		fi
 		if [ "$cksum" != "$filesum" ]; then
 			echo
 			msg_red "SHA256 mismatch for '$curfile:'\n$filesum\n"
 			errors=$((errors + 1))
+			return 1
 		else
-			if [ ! -f "$XBPS_SRCDISTDIR/by_sha256/${cksum}_${curfile}" ]; then
-				mkdir -p "$XBPS_SRCDISTDIR/by_sha256"
-				ln -f "$distfile" "$XBPS_SRCDISTDIR/by_sha256/${cksum}_${curfile}"
-			fi
+			distfile_link_sha256 "$distfile" "$curfile" "$cksum"
 			msg_normal_append "OK.\n"
 		fi
 	fi
@@ -155,9 +76,76 @@ link_cksum() {
 	fi
 }
 
+# Fetch $url with $fetch_cmd into the current dir as $file. xbps-fetch(1)
+# writes to $file.part, resuming what is already there; the data is
+# hashed while it arrives. Prints the sha256 of what was written to
+# $file.part, the caller checks $file once more if it doesn't match.
+fetch_file() {
+	local url="$1" file="$2" pid sum
+
+	touch "$file.part"
+	flock "$file.part" $fetch_cmd "$url" &
+	pid=$!
+	sum=$(tail --pid=$pid -s 0.1 -c +1 -f "$file.part" 2>/dev/null | sha256sum)
+	wait $pid
+	echo "${sum%% *}"
+}
+
+# Fetch $curfile from all mirrors passed at once, each into its own dir,
+# and keep the first copy with the right checksum. The lock on
+# $distfile.part is held meanwhile, like fetch_file() does.
+race_mirrors() {
+	local curfile="$1" distfile="$2" cksum="$3" basefile="$4" mirror pid i=0 f
+	local racedir lfd
+	local -A racers
+	shift 4
+
+	exec {lfd}>>"$distfile.part" || return
+	flock $lfd
+	if [ -f "$distfile" ]; then
+		exec {lfd}>&-
+		return
+	fi
+	racedir=$(mktemp -d "$distfile.race.XXXXXXXX") || { exec {lfd}>&-; return; }
+	msg_normal "$pkgver: fetching distfile '$curfile' from the fastest of: $*...\n"
+	for mirror; do
+		mkdir -p "$racedir/$i"
+		(
+			exec {lfd}>&-
+			cd "$racedir/$i" || exit 1
+			trap 'kill $child 2>/dev/null; exit 1' TERM
+			$fetch_cmd "$mirror/$curfile" &
+			child=$!; wait $child
+			if [ ! -f "$curfile" -a "$basefile" != "$curfile" ]; then
+				$fetch_cmd "$mirror/$basefile" &
+				child=$!; wait $child
+			fi
+		) &>/dev/null &
+		racers[$!]=$i
+		i=$((i + 1))
+	done
+	while [ ${#racers[@]} -gt 0 ]; do
+		wait -n -p pid "${!racers[@]}"
+		f="$racedir/${racers[$pid]}/$curfile"
+		unset racers[$pid]
+		if [ -f "$f" ] && [ "$(${XBPS_DIGEST_CMD} "$f")" = "$cksum" ]; then
+			mv -f "$f" "$distfile"
+			dfsum="$cksum"
+			break
+		fi
+	done
+	if [ ${#racers[@]} -gt 0 ]; then
+		kill "${!racers[@]}" 2>/dev/null
+		wait "${!racers[@]}"
+	fi
+	rm -rf "$racedir"
+	exec {lfd}>&-
+}
+
 try_mirrors() {
 	local curfile="$1" distfile="$2" dfcount="$3" subdir="$4" f="$5"
 	local filesum cksum basefile mirror path scheme
+	local -a mirrors
 	[ -z "$XBPS_DISTFILES_MIRROR" ] && return
 	basefile="${f##*/}"
 	cksum=$(get_cksum $curfile $dfcount)
@@ -181,24 +169,88 @@ try_mirrors() {
 			# For distfiles.voidlinux.* append the subdirectory
 			mirror="$mirror/$subdir"
 		fi
+		mirrors+=("$mirror")
+	done
+	# Race the first XBPS_DISTFILES_MIRROR_RACE mirrors, then go on
+	# with the others one by one.
+	if [ "${XBPS_DISTFILES_MIRROR_RACE:-1}" -gt 1 -a ${#mirrors[@]} -gt 1 ]; then
+		race_mirrors "$curfile" "$distfile" "$cksum" "$basefile" \
+			"${mirrors[@]:0:$XBPS_DISTFILES_MIRROR_RACE}"
+		[ -f "$distfile" ] && return
+		mirrors=("${mirrors[@]:$XBPS_DISTFILES_MIRROR_RACE}")
+	fi
+	for mirror in "${mirrors[@]}"; do
 		msg_normal "$pkgver: fetching distfile '$curfile' from '$mirror'...\n"
-		$fetch_cmd "$mirror/$curfile"
+		filesum=$(fetch_file "$mirror/$curfile" "$curfile")
 		# If basefile was not found, but a curfile file may exist, try to fetch it
 		if [ ! -f "$distfile" -a "$basefile" != "$curfile" ]; then
 			$fetch_cmd "$mirror/$basefile"
 		fi
 		[ ! -f "$distfile" ] && continue
 		flock -n ${distfile}.part rm -f ${distfile}.part
-		filesum=$(${XBPS_DIGEST_CMD} "$distfile")
-		[ "$cksum" == "$filesum" ] && break
+		if [ "$cksum" != "$filesum" ]; then
+			filesum=$(${XBPS_DIGEST_CMD} "$distfile")
+		fi
+		if [ "$cksum" == "$filesum" ]; then
+			dfsum="$filesum"
+			break
+		fi
 		msg_normal "$pkgver: checksum failed - removing '$curfile'...\n"
 		rm -f ${distfile}
 	done
 }
 
+# Fetch and verify the distfile at index $dfcount, run by run_jobs().
+# Messages are kept on stdout, so that they are printed in order.
+fetch_distfile() {
+	local dfcount="$1" f="${_distfiles[$1]}" curfile distfile max_retries retry dfsum=
+
+	curfile="${f#*>}"
+	curfile="${curfile##*/}"
+	distfile="$srcdir/$curfile"
+
+	# If file lock cannot be acquired wait until it's available.
+	while true; do
+		flock -w 1 ${distfile}.part true
+		[ $? -eq 0 ] && break
+		msg_warn "$pkgver: ${curfile} is already being downloaded, waiting for 1s ...\n"
+	done
+	# If distfile does not exist, try to link to it.
+	if [ ! -f "$distfile" ]; then
+		link_cksum $curfile $distfile $dfcount
+	fi
+	# If distfile does not exist, download it from a mirror location.
+	if [ ! -f "$distfile" ]; then
+		try_mirrors $curfile $distfile $dfcount $pkgname-$version $f
+	fi
+	# If distfile does not exist, download it from the original location.
+	if [[ "$FTP_RETRIES" && "${f}" =~ ^ftp:// ]]; then
+		max_retries="$FTP_RETRIES"
+	else
+		max_retries=1
+	fi
+	for retry in $(seq 1 1 $max_retries); do
+		if [ ! -f "$distfile" ]; then
+			if [ "$retry" == 1 ]; then
+				msg_normal "$pkgver: fetching distfile '$curfile'...\n"
+			else
+				msg_normal "$pkgver: fetch attempt $retry of $max_retries...\n"
+			fi
+			dfsum=$(fetch_file "$f" "$curfile")
+		fi
+	done
+	if [ ! -f "$distfile" ]; then
+		msg_error "$pkgver: failed to fetch $curfile.\n"
+	fi
+	# distfile downloaded, verify sha256 hash.
+	flock -n ${distfile}.part rm -f ${distfile}.part
+	verify_cksum $curfile $distfile $dfcount "$dfsum"
+} 2>&1
+
 hook() {
 	local srcdir="$XBPS_SRCDISTDIR/$pkgname-$version"
-	local dfcount=0 dfgood=0 errors=0 max_retries
+	local dfcount=0 dfgood=0 errors=0
+	local -a _distfiles
 
 	if [ ! -d "$srcdir" ]; then
 		mkdir -p -m775 "$srcdir"
@@ -216,7 +268,10 @@ hook() {
 		TAR_CMD="$(command -v tar)"
 	fi
 
-	# Detect distfiles with obsolete checksum and purge them from the cache
+	rm -f $(distfiles_unverified)
+
+	# Detect distfiles with obsolete checksum and purge them from the cache.
+	# Those verified while extracting are purged by do-extract.
 	for f in ${distfiles}; do
 		curfile="${f#*>}"
 		curfile="${curfile##*/}"
@@ -224,71 +279,34 @@ hook() {
 
 		if [ -f "$distfile" ]; then
 			cksum=$(get_cksum $curfile $dfcount)
-			if [ "${cksum:0:1}" = "@" ]; then
+			if distfile_verified_by_extract $curfile; then
+				echo "$cksum $curfile" >> $(distfiles_unverified)
+				filesum="$cksum"
+			elif [ "${cksum:0:1}" = "@" ]; then
 				cksum=${cksum:1}
-				filesum=$(contents_cksum "$distfile")
+				filesum=$(distfile_contents_cksum "$distfile")
 			else
 				filesum=$(${XBPS_DIGEST_CMD} "$distfile")
 			fi
 			if [ "$cksum" = "$filesum" ]; then
 				dfgood=$((dfgood + 1))
 			else
-				inode=$(stat "$distfile" --printf "%i")
 				msg_warn "$pkgver: wrong checksum found for ${curfile} - purging\n"
-				find ${XBPS_SRCDISTDIR} -inum ${inode} -delete -print
+				distfile_purge "$distfile"
 			fi
 		fi
+		_distfiles+=("$f")
 		dfcount=$((dfcount + 1))
 	done
 
 	# We're done, if all distfiles were found and had good checksums
 	[ $dfcount -eq $dfgood ] && return
 
-	# Download missing distfiles and verify their checksums
-	dfcount=0
-	for f in ${distfiles}; do
-		curfile="${f#*>}"
-		curfile="${curfile##*/}"
-		distfile="$srcdir/$curfile"
-
-		# If file lock cannot be acquired wait until it's available.
-		while true; do
-			flock -w 1 ${distfile}.part true
-			[ $? -eq 0 ] && break
-			msg_warn "$pkgver: ${curfile} is already being downloaded, waiting for 1s ...\n"
-		done
-		# If distfile does not exist, try to link to it.
-		if [ ! -f "$distfile" ]; then
-			link_cksum $curfile $distfile $dfcount
-		fi
-		# If distfile does not exist, download it from a mirror location.
-		if [ ! -f "$distfile" ]; then
-			try_mirrors $curfile $distfile $dfcount $pkgname-$version $f
-		fi
-		# If distfile does not exist, download it from the original location.
-		if [[ "$FTP_RETRIES" && "${f}" =~ ^ftp:// ]]; then
-			max_retries="$FTP_RETRIES"
-		else
-			max_retries=1
-		fi
-		for retry in $(seq 1 1 $max_retries); do
-			if [ ! -f "$distfile" ]; then
-				if [ "$retry" == 1 ]; then
-					msg_normal "$pkgver: fetching distfile '$curfile'...\n"
-				else
-					msg_normal "$pkgver: fetch attempt $retry of $max_retries...\n"
-				fi
-				flock "${distfile}.part" $fetch_cmd "$f"
-			fi
-		done
-		if [ ! -f "$distfile" ]; then
-			msg_error "$pkgver: failed to fetch $curfile.\n"
-		fi
-		# distfile downloaded, verify sha256 hash.
-		flock -n ${distfile}.part rm -f ${distfile}.part
-		verify_cksum $curfile $distfile $dfcount
-		dfcount=$((dfcount + 1))
-	done
+	# Download missing distfiles and verify their checksums, up to
+	# XBPS_FETCH_JOBS at once.
+	if ! run_jobs ${XBPS_FETCH_JOBS:-4} fetch_distfile ${!_distfiles[@]}; then
+		errors=1
+	fi
 
 	unset TAR_CMD
 
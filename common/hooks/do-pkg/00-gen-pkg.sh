@@ -4,7 +4,7 @@ genpkg() {
 	local pkgdir="$1" arch="$2" desc="$3" pkgver="$4" binpkg="$5"
 	local _preserve _deps _shprovides _shrequires _gitrevs _provides _conflicts
 	local _replaces _reverts _mutable_files _conf_files f
-	local _pkglock="$pkgdir/${binpkg}.lock"
+	local _pkglock="$pkgdir/${binpkg}.lock" _pkglockfd _exittrap
 
 	if [ ! -d "${PKGDESTDIR}" ]; then
 		msg_warn "$pkgver: cannot find pkg destdir... skipping!\n"
@@ -13,21 +13,31 @@ genpkg() {
 
 	[ ! -d $pkgdir ] && mkdir -p $pkgdir
 
-	while [ -f "$_pkglock" ]; do
-		msg_warn "${pkgver}: binpkg is being created, waiting for 1s...\n"
-		sleep 1
+	# Lock binpkg. The lock file is removed when done, so make sure that
+	# the file locked is still there.
+	while :; do
+		exec {_pkglockfd}>>"$_pkglock"
+		if ! flock -n $_pkglockfd; then
+			msg_warn "${pkgver}: binpkg is being created, waiting...\n"
+			flock $_pkglockfd
+		fi
+		[ /proc/self/fd/$_pkglockfd -ef "$_pkglock" ] && break
+		exec {_pkglockfd}>&-
 	done
+	_exittrap=$(trap -p EXIT)
+	trap "rm -f '$_pkglock'" ERR
+	exit_trap_add "rm -f '$_pkglock'"
 
 	# Don't overwrite existing binpkgs by default, skip them.
 	if [ -e $pkgdir/$binpkg ] && [ "$XBPS_PRESERVE_PKGS" ] && [ -z "$XBPS_BUILD_FORCEMODE" ]; then
 		msg_normal "${pkgver}: skipping existing $binpkg pkg...\n"
+		rm -f "$_pkglock"
+		exec {_pkglockfd}>&-
+		trap - ERR EXIT
+		eval "$_exittrap"
 		return 0
 	fi
 
-	# Lock binpkg
-	trap "rm -f '$_pkglock'" ERR EXIT
-	touch -f "$_pkglock"
-
 	if [ ! -d $pkgdir ]; then
 		mkdir -p $pkgdir
 	fi
@@ -92,7 +102,9 @@ genpkg() {
 
 	# Unlock binpkg
 	rm -f "$_pkglock"
+	exec {_pkglockfd}>&-
 	trap - ERR EXIT
+	eval "$_exittrap"
 
 	if [ $rval -ne 0 ]; then
 		rm -f $pkgdir/$binpkg
@@ -15,7 +15,7 @@ hook() {
 		rm -f ${PKGDESTDIR}/usr/share/info/dir
 	fi
 
-	find ${PKGDESTDIR}/usr/share/info -type f -follow | while read f
+	destdir_files fl '^usr/share/info/' | while read f
 	do
 		j=$(echo "$f"|sed -e "$fpattern")
 		[ "$j" = "" ] && continue
@@ -40,4 +40,5 @@ hook() {
 		echo "   Compressing info file: $j..."
 		gzip -nfq9 ${PKGDESTDIR}/"$j"
 	done
+	destdir_files_update ${PKGDESTDIR}/usr/share/info
 }
@@ -8,4 +8,5 @@
 hook() {
 	[ -z "$CROSS_BUILD" ] && return
 	rm -f "${PKGDESTDIR}/usr/${XBPS_CROSS_TRIPLET}/usr"
+	destdir_files_update "${PKGDESTDIR}/usr/${XBPS_CROSS_TRIPLET}/usr"
 }
@@ -3,5 +3,6 @@
 hook() {
 	if [ "${pkgname}" != "base-files" ]; then
 		rm -f ${PKGDESTDIR}/usr/lib${XBPS_TARGET_WORDSIZE}
+		destdir_files_update ${PKGDESTDIR}/usr/lib${XBPS_TARGET_WORDSIZE}
 	fi
 }
@@ -4,18 +4,19 @@ hook() {
 	local f lnkat mandir=${PKGDESTDIR}/usr/share/man
 
 	if [ ! -d $mandir ] ||
-	   [ -z "$(find $mandir -regex '.*\.\(gz\|bz2\)' -print -quit)" ]; then
+	   [ -z "$(destdir_files '' '^usr/share/man/.*\.(gz|bz2)$')" ]; then
 		return 0
 	fi
 
 	# rewrite symlinks
-	find $mandir -type l -regex '.*\.\(gz\|bz2\)' | while read f
+	destdir_files l '^usr/share/man/.*\.(gz|bz2)$' | while read f
 	do
 		lnkat=$(readlink "$f")
 		ln -s ${lnkat%.*} ${f%.*}
 		rm $f
 	done
 
-	find $mandir -type f -name '*.gz' -exec gunzip -v -f {} + &>/dev/null
-	find $mandir -type f -name '*.bz2' -exec bunzip2 -v -f {} + &>/dev/null
+	destdir_files f '^usr/share/man/.*\.gz$' | xargs -r -d '\n' gunzip -v -f &>/dev/null
+	destdir_files f '^usr/share/man/.*\.bz2$' | xargs -r -d '\n' bunzip2 -v -f &>/dev/null
+	destdir_files_update $mandir
 }
@@ -7,5 +7,6 @@ hook() {
 	# Remove charset.alias on musl
 	if [ -f $PKGDESTDIR/usr/lib/charset.alias ]; then
 		rm -f $PKGDESTDIR/usr/lib/charset.alias
+		destdir_files_update $PKGDESTDIR/usr/lib/charset.alias
 	fi
 }
@@ -2,6 +2,6 @@
 
 hook() {
 	if [ -z "$keep_libtool_archives" -a -d "${PKGDESTDIR}" ]; then
-		find ${PKGDESTDIR} -name \*.la -delete
+		destdir_files_delete fl '\.la$'
 	fi
 }
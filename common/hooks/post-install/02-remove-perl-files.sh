@@ -2,7 +2,7 @@
 
 hook() {
 	if [ "$pkgname" != "perl" -a -d "${PKGDESTDIR}" ]; then
-		find ${PKGDESTDIR} -type f -name perllocal.pod -delete
-		find ${PKGDESTDIR} -type f -name .packlist -delete
+		destdir_files_delete f '(^|/)perllocal\.pod$'
+		destdir_files_delete f '(^|/)\.packlist$'
 	fi
 }
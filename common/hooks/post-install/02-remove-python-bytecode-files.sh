@@ -2,6 +2,6 @@
 
 hook() {
     if [ -d "${PKGDESTDIR}" ]; then
-        find ${PKGDESTDIR} -type f -name '*.py[co]' -delete
+        destdir_files_delete f '\.py[co]$'
     fi
 }
@@ -1,8 +1,14 @@
 # This hooks removes empty dirs and warns about them.
 
 hook() {
+    local -a dirs
+
     if [ -d "${PKGDESTDIR}" ]; then
-        find "${PKGDESTDIR}" -mindepth 1 -type d -empty -print -delete|sort -r|while read f; do
+        mapfile -t dirs < <(destdir_empty_dirs)
+        [ ${#dirs[@]} -gt 0 ] || return 0
+        rmdir "${dirs[@]}"
+        destdir_files_update "${dirs[@]}"
+        printf "%s\n" "${dirs[@]}"|sort -r|while read f; do
             _dir="${f##${PKGDESTDIR}}"
             msg_warn "$pkgver: removed empty dir: ${_dir}\n"
         done
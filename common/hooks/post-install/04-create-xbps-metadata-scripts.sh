@@ -128,7 +128,7 @@ _EOF
 	#
 	if [ -d "${PKGDESTDIR}/usr/share/info" ]; then
 		unset info_files
-		for f in $(find ${PKGDESTDIR}/usr/share/info -type f); do
+		for f in $(destdir_files f '^usr/share/info/'); do
 			j=$(echo $f|sed -e "$fpattern")
 			[ "$j" = "" ] && continue
 			[ "$j" = "/usr/share/info/dir" ] && continue
@@ -403,4 +403,6 @@ hook() {
 	if [ -s ${msg_remove} ]; then
 		install -m644 ${msg_remove} ${PKGDESTDIR}/REMOVE.msg
 	fi
+	destdir_files_update ${PKGDESTDIR}/INSTALL ${PKGDESTDIR}/REMOVE \
+		${PKGDESTDIR}/INSTALL.msg ${PKGDESTDIR}/REMOVE.msg
 }
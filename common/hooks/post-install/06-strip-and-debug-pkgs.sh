@@ -12,7 +12,7 @@ make_debug() {
 	dbgfile="${dname}/${fname}"
 
 	mkdir -p "${PKGDESTDIR}/usr/lib/debug/${dname}"
-	$OBJCOPY --only-keep-debug --compress-debug-sections \
+	$OBJCOPY --only-keep-debug ${_dbgcompress} \
 		"$1" "${PKGDESTDIR}/usr/lib/debug/${dbgfile}"
 	if [ $? -ne 0 ]; then
 		msg_red "${pkgver}: failed to create dbg file: ${dbgfile}\n"
@@ -25,6 +25,8 @@ attach_debug() {
 	local dname= fname= dbgfile=
 
 	[ -n "$nodebug" ] && return 0
+	# done by 07-dedup-debug-pkgs, once dwz(1) changed the debug file.
+	[ -n "$_dbgdwz" ] && return 0
 
 	dname=${1%/*}/ ; dname=${dname#$PKGDESTDIR}
 	fname="${1##*/}"
@@ -37,6 +39,22 @@ attach_debug() {
 	fi
 }
 
+# Gives the hard link $2 of the stripped file $1 the debug file of $1.
+link_debug() {
+	local dbgfile= lnkfile=
+
+	[ -n "$nodebug" ] && return 0
+
+	dbgfile=${1#$PKGDESTDIR} ; lnkfile=${2#$PKGDESTDIR}
+	[ -f "${PKGDESTDIR}/usr/lib/debug/${dbgfile}" ] || return 0
+	mkdir -p "${PKGDESTDIR}/usr/lib/debug/${lnkfile%/*}"
+	if ! ln -f "${PKGDESTDIR}/usr/lib/debug/${dbgfile}" \
+		"${PKGDESTDIR}/usr/lib/debug/${lnkfile}"; then
+		msg_red "${pkgver}: failed to create dbg file: ${lnkfile}\n"
+		return 1
+	fi
+}
+
 create_debug_pkg() {
 	local _pkgname= _destdir=
 
@@ -56,16 +74,108 @@ create_debug_pkg() {
 	return 0
 }
 
+# Strips the file with the given index in the lists collected by hook(),
+# run in parallel by run_jobs(). Other hard links of the file are not
+# stripped again, they only get its debug file. Errors go to stdout too,
+# so that they are printed in order with the other messages.
+strip_file() {
+	local f="${_strip_files[$1]}" elftype="${_strip_types[$1]}"
+	local elfmach="${_strip_machs[$1]}" elfinterp="${_strip_interps[$1]}" lnk=
+
+	strip_elf "$f" "$elftype" "$elfmach" "$elfinterp" || return $?
+	while read -r lnk; do
+		[ -n "$lnk" ] || continue
+		link_debug "$f" "$lnk" || return $?
+		echo "   Hard link of ${f#$PKGDESTDIR}: ${lnk#$PKGDESTDIR}"
+	done <<< "${_strip_links[$1]}"
+} 2>&1
+
+strip_elf() {
+	local f="$1" elftype="$2" elfmach="$3" elfinterp="$4" x=
+
+	case "$elftype" in
+	exec|static)
+		chmod +w "$f"
+		if [ "$elftype" = "static" ]; then
+			# static binary
+			if ! $STRIPCMD "$f"; then
+				msg_red "$pkgver: failed to strip ${f#$PKGDESTDIR}\n"
+				return 1
+			fi
+			echo "   Stripped static executable: ${f#$PKGDESTDIR}"
+		else
+			make_debug "$f"
+			if ! $STRIPCMD "$f"; then
+				msg_red "$pkgver: failed to strip ${f#$PKGDESTDIR}\n"
+				return 1
+			fi
+			echo "   Stripped executable: ${f#$PKGDESTDIR}"
+			unset nopie_found
+			for x in ${nopie_files}; do
+				if [ "$x" = "${f#$PKGDESTDIR}" ]; then
+					nopie_found=1
+					break
+				fi
+			done
+			if [ -z "$nopie" ] && [ -z "$nopie_found" ]; then
+				msg_red "$pkgver: non-PIE executable found in PIE build: ${f#$PKGDESTDIR}\n"
+				return 1
+			fi
+			attach_debug "$f"
+		fi
+		;;
+	shared|pie)
+		if [ "$elfmach" = "None" ]; then
+			# using ELF as a container format (e.g. guile)
+			echo "   Ignoring ELF file without machine set: ${f#$PKGDESTDIR}"
+			return 0
+		fi
+
+		chmod +w "$f"
+		# shared library
+		make_debug "$f"
+		if ! $STRIPCMD --strip-unneeded "$f"; then
+			msg_red "$pkgver: failed to strip ${f#$PKGDESTDIR}\n"
+			return 1
+		fi
+		if [ "$elfinterp" != "-" ]; then
+			echo "   Stripped position-independent executable: ${f#$PKGDESTDIR}"
+		else
+			echo "   Stripped library: ${f#$PKGDESTDIR}"
+		fi
+		attach_debug "$f"
+		;;
+	archive)
+		chmod +w "$f"
+		if ! $STRIPCMD --strip-debug "$f"; then
+			msg_red "$pkgver: failed to strip ${f#$PKGDESTDIR}\n"
+			return 1
+		fi
+		echo "   Stripped static library: ${f#$PKGDESTDIR}";;
+	esac
+}
+
 hook() {
-	local fname= x= f= _soname= STRIPCMD=
+	local fname= x= f= found= STRIPCMD= _dbgcompress= _dbgdwz=
+	local elftype= elfmach= elfinterp= elfsoname= elfneeded=
+	local -a _strip_files _strip_types _strip_machs _strip_interps
+	local -a _strip_links inodes jobs
+	local -A first
+	local ino=
 
 	if [ -n "$nostrip" ]; then
 		return 0
 	fi
 
 	STRIPCMD=/usr/bin/$STRIP
+	if debug_dwz_enabled; then
+		# dwz(1) skips compressed debug files
+		_dbgdwz=1
+	else
+		_dbgcompress=$(debug_compress_arg)
+	fi
 
-	find ${PKGDESTDIR} -type f | while read f; do
+	while IFS=$'\t' read -r f elftype elfmach elfinterp elfsoname elfneeded; do
 		if [[ $f =~ ^${PKGDESTDIR}/usr/lib/debug/ ]]; then
 			continue
 		fi
@@ -81,68 +191,35 @@ hook() {
 			unset found
 			continue
 		fi
-		case "$(file -bi "$f")" in
-		application/x-executable*)
-			chmod +w "$f"
-			if [[ $(file $f) =~ "statically linked" ]]; then
-				# static binary
-				if ! $STRIPCMD "$f"; then
-					msg_red "$pkgver: failed to strip ${f#$PKGDESTDIR}\n"
-					return 1
-				fi
-				echo "   Stripped static executable: ${f#$PKGDESTDIR}"
-			else
-				make_debug "$f"
-				if ! $STRIPCMD "$f"; then
-					msg_red "$pkgver: failed to strip ${f#$PKGDESTDIR}\n"
-					return 1
-				fi
-				echo "   Stripped executable: ${f#$PKGDESTDIR}"
-				unset nopie_found
-				for x in ${nopie_files}; do
-					if [ "$x" = "${f#$PKGDESTDIR}" ]; then
-						nopie_found=1
-						break
-					fi
-				done
-				if [ -z "$nopie" ] && [ -z "$nopie_found" ]; then
-					msg_red "$pkgver: non-PIE executable found in PIE build: ${f#$PKGDESTDIR}\n"
-					return 1
-				fi
-				attach_debug "$f"
-			fi
-			;;
-		application/x-sharedlib*|application/x-pie-executable*)
-			local type="$(file -b "$f")"
-			if [[ $type =~ "no machine" ]]; then
-				# using ELF as a container format (e.g. guile)
-				echo "   Ignoring ELF file without machine set: ${f#$PKGDESTDIR}"
-				continue
-			fi
-
-			chmod +w "$f"
-			# shared library
-			make_debug "$f"
-			if ! $STRIPCMD --strip-unneeded "$f"; then
-				msg_red "$pkgver: failed to strip ${f#$PKGDESTDIR}\n"
-				return 1
-			fi
-			if [[ $type =~ "interpreter " ]]; then
-				echo "   Stripped position-independent executable: ${f#$PKGDESTDIR}"
-			else
-				echo "   Stripped library: ${f#$PKGDESTDIR}"
-			fi
-			attach_debug "$f"
-			;;
-		application/x-archive*)
-			chmod +w "$f"
-			if ! $STRIPCMD --strip-debug "$f"; then
-				msg_red "$pkgver: failed to strip ${f#$PKGDESTDIR}\n"
-				return 1
-			fi
-			echo "   Stripped static library: ${f#$PKGDESTDIR}";;
-		esac
+		_strip_files+=("$f")
+		_strip_types+=("$elftype")
+		_strip_machs+=("$elfmach")
+		_strip_interps+=("$elfinterp")
+	done < <(destdir_elf)
+
+	# hard links of a file must not be stripped concurrently: strip only
+	# the first path of every inode, along with its other links.
+	if [ ${#_strip_files[@]} -gt 0 ]; then
+		mapfile -t inodes < <(printf '%s\0' "${_strip_files[@]}" |
+			xargs -0 stat -c '%d:%i' --)
+	fi
+	for x in ${!_strip_files[@]}; do
+		ino=${inodes[$x]:-$x}
+		if [ -n "${first[$ino]}" ]; then
+			_strip_links[${first[$ino]}]+="${_strip_files[$x]}"$'\n'
+		else
+			first[$ino]=$x
+			jobs+=($x)
+		fi
 	done
-	create_debug_pkg
-	return $?
+
+	# files are stripped in parallel, their messages are printed in order.
+	if ! run_jobs ${XBPS_MAKEJOBS:-1} strip_file ${jobs[@]}; then
+		return 1
+	fi
+	destdir_files_update "${_strip_files[@]}"
+	create_debug_pkg || return $?
+	destdir_files_update ${PKGDESTDIR}/usr/lib/debug
+	[ -d ${PKGDESTDIR}/usr/lib ] || destdir_files_update ${PKGDESTDIR}/usr/lib
+	return 0
 }
@@ -0,0 +1,125 @@
+# This hook executes the following tasks:
+#	- deduplicates the debug files of all -dbg pkgs with dwz(1)
+#	- compresses them and links them to the stripped binaries
+
+# Compresses the debug file with the given index in the list collected by
+# hook() and adds its debuglink to the binaries of all of its hard links,
+# run by run_jobs().
+dedup_debug_file() {
+	local f="${_dbgfiles[$1]}" i bin
+
+	if [ -n "${_dbgcompress}" ] && ! $OBJCOPY ${_dbgcompress} "$f"; then
+		msg_red "${pkgver}: failed to compress dbg file: ${f##*/usr/lib/debug}\n"
+		return 1
+	fi
+	for i in $1 ${_dbglinks[$1]}; do
+		bin="${_dbgbins[$i]}"
+		[ -n "$bin" ] || continue
+		if ! $OBJCOPY --add-gnu-debuglink="${_dbgfiles[$i]}" "$bin"; then
+			msg_red "${pkgver}: failed to attach dbg to ${_dbgfiles[$i]##*/usr/lib/debug}\n"
+			return 1
+		fi
+	done
+} 2>&1
+
+hook() {
+	local p f i ino dbgdir mfdir multifile _dbgcompress
+	local -a _dbgfiles _dbgpkgs _dbgbins _dbglinks dbgpkgs inodes jobs
+	local -a bins binidx bininodes
+	local -A before first linked
+
+	[ -n "$nodebug" -o -n "$nostrip" ] && return 0
+	# all -dbg pkgs exist once the sourcepkg, installed last, is reached.
+	[ "$pkgname" = "$sourcepkg" ] || return 0
+	debug_dwz_enabled || return 0
+
+	for p in ${subpackages} ${sourcepkg}; do
+		dbgdir=${XBPS_DESTDIR}/${XBPS_CROSS_TRIPLET}/${p}-dbg-${version}
+		[ -d ${dbgdir}/usr/lib/debug ] || continue
+		dbgpkgs+=($p)
+		before[$p]=$(du -sk ${dbgdir} | cut -f1)
+		while read -r f; do
+			_dbgfiles+=("$f")
+			_dbgpkgs+=("$p")
+		done < <(find ${dbgdir}/usr/lib/debug -path '*/.dwz' -prune -o -type f -print)
+	done
+	[ ${#_dbgfiles[@]} -gt 0 ] || return 0
+
+	# Debug info shared by several files is moved to a common file in the
+	# -dbg pkg of the sourcepkg, which the other -dbg pkgs then depend on.
+	msg_normal "${pkgver}: deduplicating debug files with dwz ...\n"
+	if [ ${#_dbgfiles[@]} -gt 1 ]; then
+		mfdir=${XBPS_DESTDIR}/${XBPS_CROSS_TRIPLET}/${sourcepkg}-dbg-${version}/usr/lib/debug/.dwz
+		multifile=${sourcepkg}-${version}_${revision}.debug
+		mkdir -p ${mfdir}
+		dwz -q -h -m ${mfdir}/${multifile} -M /usr/lib/debug/.dwz/${multifile} \
+			"${_dbgfiles[@]}" || msg_warn "${pkgver}: dwz failed for some debug files\n"
+		if [ -f ${mfdir}/${multifile} ]; then
+			chmod 644 ${mfdir}/${multifile}
+			_dbgfiles+=(${mfdir}/${multifile})
+			_dbgpkgs+=("")
+			dbgdir=${XBPS_DESTDIR}/${XBPS_CROSS_TRIPLET}/${sourcepkg}-dbg-${version}
+			if [ ! -s ${dbgdir}/rdeps ]; then
+				printf "${sourcepkg}-${version}_${revision} " >> ${dbgdir}/rdeps
+				dbgpkgs+=(${sourcepkg})
+				before[${sourcepkg}]=0
+			fi
+			for p in ${dbgpkgs[@]}; do
+				[ "$p" = "${sourcepkg}" ] && continue
+				f=${XBPS_DESTDIR}/${XBPS_CROSS_TRIPLET}/${p}-dbg-${version}/rdeps
+				grep -qF "${sourcepkg}-dbg-" $f 2>/dev/null ||
+					printf "${sourcepkg}-dbg-${version}_${revision} " >> $f
+			done
+		else
+			# drop the -dbg pkg of the sourcepkg if it was only made here
+			rmdir -p ${mfdir} 2>/dev/null
+		fi
+	else
+		dwz -q -h "${_dbgfiles[@]}" || msg_warn "${pkgver}: dwz failed for ${_dbgfiles##*/usr/lib/debug}\n"
+	fi
+
+	# Hard links of a debug file, and of a binary, must not be changed
+	# concurrently: there is a job per debug file inode, and a debuglink
+	# is added once per binary inode.
+	mapfile -t inodes < <(printf '%s\0' "${_dbgfiles[@]}" |
+		xargs -0 stat -c '%d:%i' --)
+	for i in ${!_dbgfiles[@]}; do
+		p=${_dbgpkgs[$i]}
+		[ -n "$p" ] || continue
+		f=${_dbgfiles[$i]}
+		f=${XBPS_DESTDIR}/${XBPS_CROSS_TRIPLET}/${p}-${version}${f##*/usr/lib/debug}
+		[ -f "$f" ] && bins[$i]=$f
+	done
+	if [ ${#bins[@]} -gt 0 ]; then
+		binidx=(${!bins[@]})
+		mapfile -t bininodes < <(printf '%s\0' "${bins[@]}" |
+			xargs -0 stat -c '%d:%i' --)
+		for f in ${!binidx[@]}; do
+			i=${binidx[$f]}
+			ino=${bininodes[$f]:-$i}
+			[ -z "${linked[$ino]}" ] || continue
+			linked[$ino]=1
+			_dbgbins[$i]=${bins[$i]}
+		done
+	fi
+	for i in ${!_dbgfiles[@]}; do
+		ino=${inodes[$i]:-$i}
+		if [ -n "${first[$ino]}" ]; then
+			_dbglinks[${first[$ino]}]+=" $i"
+		else
+			first[$ino]=$i
+			jobs+=($i)
+		fi
+	done
+
+	_dbgcompress=$(debug_compress_arg)
+	if ! run_jobs ${XBPS_MAKEJOBS:-1} dedup_debug_file ${jobs[@]}; then
+		return 1
+	fi
+
+	for p in ${dbgpkgs[@]}; do
+		dbgdir=${XBPS_DESTDIR}/${XBPS_CROSS_TRIPLET}/${p}-dbg-${version}
+		f=$(du -sk ${dbgdir} | cut -f1)
+		echo "   ${p}-dbg: ${before[$p]} KiB -> ${f} KiB, saved $((before[$p]-f)) KiB"
+	done
+}
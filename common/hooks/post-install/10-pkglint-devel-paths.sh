@@ -16,7 +16,7 @@ hook() {
         return 0
     fi
 
-    for f in $(find $PKGDESTDIR -type d); do
+    for f in $(destdir_files d); do
         case "${f#$PKGDESTDIR}" in
             /usr/include)
                 msg_warn "usr/include should be in -devel package\n"
@@ -54,25 +54,21 @@ hook() {
         esac
     done
 
-    if [ -n "$(find $PKGDESTDIR/usr/lib -maxdepth 1 -type l -iname '*.so' 2>/dev/null)" ]; then
+    if [ -n "$(destdir_files l '^usr/lib/[^/]*\.[sS][oO]$')" ]; then
         solink=1
     fi
 
-    if [ -n "$(find $PKGDESTDIR/usr/lib -maxdepth 1 -type f -iname '*.a' 2>/dev/null)" ]; then
+    if [ -n "$(destdir_files f '^usr/lib/[^/]*\.[aA]$')" ]; then
         archive=1
     fi
 
-    if [ -d $PKGDESTDIR/usr/bin ]; then
-        for x in $(find $PKGDESTDIR/usr/bin -type f -executable -iname '*-config'); do
-            msg_warn "${x#$PKGDESTDIR\/} should be in -devel package\n"
-        done
-    fi
+    for x in $(destdir_files f '^usr/bin/.*-[cC][oO][nN][fF][iI][gG]$' 111); do
+        msg_warn "${x#$PKGDESTDIR\/} should be in -devel package\n"
+    done
 
-    if [ -d $PKGDESTDIR/usr/man/man1 ]; then
-        for m in $(find $PKGDESTDIR/usr/man/man1 -type f -iname '*-config.1'); do
-            msg_warn "${m#$PKGDESTDIR\/} should be in -devel package\n"
-        done
-    fi
+    for m in $(destdir_files f '^usr/man/man1/.*-[cC][oO][nN][fF][iI][gG]\.1$'); do
+        msg_warn "${m#$PKGDESTDIR\/} should be in -devel package\n"
+    done
 
     if [ -n "$solink" ]; then
         msg_warn "usr/lib/*.so should be in -devel package\n"
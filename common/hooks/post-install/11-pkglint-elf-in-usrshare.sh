@@ -5,39 +5,26 @@
 #   - Allows exceptions listed in $ignore_elf_files and $ignore_elf_dirs
 
 hook() {
-    local matches mime file f prune_expr dir
+    local matches file f dir elftype x
 
     if [ ! -d ${PKGDESTDIR}/usr/share ]; then
         return 0
     fi
 
-    if [ "${ignore_elf_dirs}" ]; then
+    # Find all binaries in /usr/share and add them to the pool
+    while IFS=$'\t' read -r f elftype x; do
+        file="${f#${PKGDESTDIR}}"
         for dir in ${ignore_elf_dirs}; do
-            if ! [ "${prune_expr}" ]; then
-                prune_expr="( -path ${PKGDESTDIR}${dir}"
-            else
-                prune_expr+=" -o -path ${PKGDESTDIR}${dir}"
-            fi
+            [[ ${file} == ${dir}/* ]] && continue 2
         done
-        prune_expr+=" ) -prune -o "
-    fi
-
-    # Find all binaries in /usr/share and add them to the pool
-    while read -r f; do
-        mime="${f##*:}"
-        mime="${mime// /}"
-        file="${f%:*}"
-        file="${file#${PKGDESTDIR}}"
-        case "${mime}" in
-            application/x-sharedlib*|\
-             application/x-pie-executable*|\
-             application/x-executable*)
+        case "${elftype}" in
+            exec|static|pie|shared)
                 if [[ ${ignore_elf_files} != *"${file}"* ]]; then
                     matches+=" ${file}"
                 fi
                 ;;
         esac
-    done < <(find $PKGDESTDIR/usr/share $prune_expr -type f | file --mime-type --files-from -)
+    done < <(destdir_elf '^usr/share/')
 
     # Check passed if no packages in pool
     if [ -z "$matches" ]; then
@@ -12,5 +12,6 @@ hook() {
 		modulename="${filename%%.*}"
 		msg_warn "${pkgver}: renamed '${filename}' to '${modulename}.so'.\n"
 		mv ${file} ${file%/*}/${modulename}.so
+		destdir_files_update ${file} ${file%/*}/${modulename}.so
 	done
 }
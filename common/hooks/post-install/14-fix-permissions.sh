@@ -6,15 +6,19 @@ change_file_perms() {
 	local permmask="$2"
 	# permissions which will be set on matched files
 	local perms="$3"
+	local -a files
 	if [ -d "$dir" ]; then
-		find "$dir" -type f -perm "/$permmask" -exec chmod -v "$perms" {} +
+		mapfile -t files < <(destdir_files f "^${1#/}/" "$permmask")
+		[ ${#files[@]} -gt 0 ] || return 0
+		chmod -v "$perms" "${files[@]}"
+		destdir_files_update "${files[@]}"
 	fi
 }
 
 hook() {
 	if [ -z "$nocheckperms" ]; then
 		# check that no files have permission write for other users
-		find "$PKGDESTDIR" -type f -perm -0002 | while read -r file; do
+		destdir_files f '' 0002 | while read -r file; do
 			msg_error "$pkgver: file ${file#$PKGDESTDIR} has write permission for other users\n"
 		done
 	fi
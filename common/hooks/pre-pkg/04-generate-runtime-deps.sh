@@ -43,59 +43,62 @@ store_pkgdestdir_rundeps() {
                 fi
                 printf -- "${_curdep} " >> ${PKGDESTDIR}/rdeps
             done
+            destdir_files_update ${PKGDESTDIR}/rdeps
         fi
 }
 
 hook() {
-    local depsftmp f lf j mapshlibs sorequires _curdep elfmagic
+    local depsftmp f lf j sorequires _curdep
+    local elftype elfmach elfinterp elfsoname elfneeded
+    local -A shlibs_map
 
     # Disable trap on ERR, xbps-uhelper cmd might return error... but not something
     # to be worried about because if there are broken shlibs this hook returns
     # error via msg_error().
     trap - ERR
 
-    mapshlibs=$XBPS_COMMONDIR/shlibs
-
     if [ -n "$noverifyrdeps" ]; then
         store_pkgdestdir_rundeps
         return 0
     fi
 
     depsftmp=$(mktemp) || exit 1
-    find ${PKGDESTDIR} -type f -perm -u+w > $depsftmp 2>/dev/null
+    destdir_elf '' 200 > $depsftmp
 
     exec 3<&0 # save stdin
     exec < $depsftmp
-    while read f; do
+    while IFS=$'\t' read -r f elftype elfmach elfinterp elfsoname elfneeded; do
         lf=${f#${PKGDESTDIR}}
 	    if [ "${skiprdeps/${lf}/}" != "${skiprdeps}" ]; then
 		    msg_normal "Skipping dependency scan for ${lf}\n"
 		    continue
 	    fi
-        read -n4 elfmagic < "$f"
-        if [ "$elfmagic" = $'\177ELF' ]; then
-            for nlib in $($OBJDUMP -p "$f"|awk '/NEEDED/{print $2}'); do
-                [ -z "$verify_deps" ] && verify_deps="$nlib" && continue
-                found=0
-                for j in ${verify_deps}; do
-                    [[ $j == $nlib ]] && found=1 && break
-                done
-                [[ $found -eq 0 ]] && verify_deps="$verify_deps $nlib"
+        [ "$elfneeded" = "-" ] && continue
+        for nlib in $elfneeded; do
+            [ -z "$verify_deps" ] && verify_deps="$nlib" && continue
+            found=0
+            for j in ${verify_deps}; do
+                [[ $j == $nlib ]] && found=1 && break
             done
-        fi
+            [[ $found -eq 0 ]] && verify_deps="$verify_deps $nlib"
+        done
     done
     exec 0<&3 # restore stdin
     rm -f $depsftmp
 
     #
     # Add required run time packages by using required shlibs resolved
-    # above, the mapping is done thru the common/shlibs file.
+    # above, the mapping is done thru the common/shlibs file, looked up
+    # for all shlibs at once.
     #
+    while read -r f j; do
+        shlibs_map[$f]+="${shlibs_map[$f]:+ }$j"
+    done < <(shlibs_lookup ${verify_deps})
+
     for f in ${verify_deps}; do
-        unset _f j rdep _rdep rdepcnt soname _pkgname _rdepver found
-        _f=$(echo "$f"|sed -E 's|\+|\\+|g')
-        rdep="$(grep -E "^${_f}[[:blank:]]+.*$" $mapshlibs|cut -d ' ' -f2)"
-        rdepcnt="$(grep -E "^${_f}[[:blank:]]+.*$" $mapshlibs|cut -d ' ' -f2|wc -l)"
+        unset j rdep _rdep rdepcnt soname _pkgname _rdepver found
+        rdep="${shlibs_map[$f]}"
+        rdepcnt=$(wc -w <<< "$rdep")
         if [ -z "$rdep" ]; then
             # Ignore libs by current pkg
             soname=$(find ${PKGDESTDIR} -name "$f")
@@ -167,5 +170,6 @@ hook() {
     done
     if [ -n "${sorequires}" ]; then
         echo "${sorequires}" > ${PKGDESTDIR}/shlib-requires
+        destdir_files_update ${PKGDESTDIR}/shlib-requires
     fi
 }
@@ -2,7 +2,7 @@
 #	- generates shlib-provides file for xbps-create(1)
 
 collect_sonames() {
-	local _destdir="$1" f _soname _fname _pattern
+	local _destdir="$1" f _soname _fname _pattern _type _mach _interp _needed
 	local _pattern="^[[:alnum:]]+(.*)+\.so(\.[0-9]+)*$"
 	local _versioned_pattern="^[[:alnum:]]+(.*)+\.so(\.[0-9]+)+$"
 	local _tmpfile=$(mktemp) || exit 1
@@ -13,12 +13,17 @@ collect_sonames() {
 	fi
 
 	# real pkg
-	find ${_destdir} -type f -name "*.so*" | while read f; do
+	if [ "${_destdir}" = "${PKGDESTDIR}" ]; then
+		destdir_elf '\.so[^/]*$'
+	else
+		elf_scan ${_destdir} -name "*.so*"
+	fi |
+	while IFS=$'\t' read -r f _type _mach _interp _soname _needed; do
 		_fname="${f##*/}"
-		case "$(file -bi "$f")" in
-		application/x-sharedlib*|application/x-pie-executable*)
+		case "${_type}" in
+		shared|pie)
 			# shared library
-			_soname=$(${OBJDUMP} -p "$f"|grep SONAME|awk '{print $2}')
+			[ "${_soname}" = "-" ] && _soname=
 			# Register all versioned sonames, and
 			# unversioned sonames only when in libdir.
 			if [[ ${_soname} =~ ${_versioned_pattern} ]] ||
@@ -38,6 +43,9 @@ collect_sonames() {
 	if [ -s "${_tmpfile}" ]; then
 		tr '\n' ' ' < "${_tmpfile}" > ${_destdir}/shlib-provides
 		echo >> ${_destdir}/shlib-provides
+		if [ "${_destdir}" = "${PKGDESTDIR}" ]; then
+			destdir_files_update ${_destdir}/shlib-provides
+		fi
 	fi
 	rm -f ${_tmpfile}
 }
@@ -37,6 +37,54 @@ readonly SOURCEPKG="$sourcepkg"
 
 check_existing_pkg
 
+# Run a phase and remember how long it took, for build_times_save.
+run_phase() {
+    local phase="$1" start=$SECONDS
+    shift
+
+    telemetry_begin
+    "$@" || exit 1
+    telemetry_end phase $phase
+    phase_times+="$phase $((SECONDS-start))\n"
+}
+
+# Registering packages at once per repository. This makes sure that staging is
+# triggered for all new packages if any of them introduces inconsistencies.
+# Concurrent builds queue their packages and register them in batches, see
+# rindex.sh.
+register_pkgs() {
+    local arch repo force rval=0
+
+    if [ -z "$XBPS_PRESERVE_PKGS" ] || [ "$XBPS_BUILD_FORCEMODE" ]; then
+        force=-f
+    fi
+    cut -d: -f 1,2 ${XBPS_STATEDIR}/.${sourcepkg}_register_pkg | sort -u | \
+        while IFS=: read -r arch repo; do
+            rindex_queue $repo ${arch:-$XBPS_TARGET_MACHINE} "$force" \
+                $(grep "^$arch:$repo:" "${XBPS_STATEDIR}/.${sourcepkg}_register_pkg" | \
+                    cut -d : -f 3)
+        done
+    while read -r repo; do
+        rindex_commit $repo $(awk -F: -v r="$repo" '$2 == r { print $3 }' \
+            ${XBPS_STATEDIR}/.${sourcepkg}_register_pkg) || rval=1
+    done < <(cut -d: -f 2 ${XBPS_STATEDIR}/.${sourcepkg}_register_pkg | sort -u)
+    return $rval
+}
+
+# pkg cleanup
+pkg_cleanup() {
+    if declare -f do_clean >/dev/null; then
+        run_func do_clean
+    fi
+
+    if [ -n "$XBPS_DEPENDENCY" -o -z "$XBPS_KEEP_ALL" ]; then
+        remove_pkg_autodeps
+        remove_pkg_wrksrc
+        remove_pkg $XBPS_CROSS_BUILD
+        remove_pkg_statedir
+    fi
+}
+
 show_pkg_build_options
 check_pkg_arch $XBPS_CROSS_BUILD
 
@@ -52,39 +100,50 @@ if [ "$XBPS_CROSS_BUILD" ]; then
     install_cross_pkg $XBPS_CROSS_BUILD || exit $?
 fi
 
+# Look up the binpkgs in the build cache, once the build dependencies
+# whose versions are part of the key are installed.
+if [ -n "$XBPS_BUILD_CACHE" -a "$XBPS_TARGET" = "pkg" ]; then
+    build_cache_key=$(build_cache_key)
+    if [ -z "$XBPS_BUILD_FORCEMODE" ] && build_cache_restore $build_cache_key; then
+        register_pkgs || exit $?
+        pkg_cleanup
+        exit 0
+    fi
+fi
+
 # Fetch distfiles after installing required dependencies,
 # because some of them might be required for do_fetch().
-$XBPS_LIBEXECDIR/xbps-src-dofetch.sh $SOURCEPKG $XBPS_CROSS_BUILD || exit 1
+run_phase fetch $XBPS_LIBEXECDIR/xbps-src-dofetch.sh $SOURCEPKG $XBPS_CROSS_BUILD
 [ "$XBPS_TARGET" = "fetch" ] && exit 0
 
 # Fetch, extract, build and install into the destination directory.
-$XBPS_LIBEXECDIR/xbps-src-doextract.sh $SOURCEPKG $XBPS_CROSS_BUILD || exit 1
+run_phase extract $XBPS_LIBEXECDIR/xbps-src-doextract.sh $SOURCEPKG $XBPS_CROSS_BUILD
 [ "$XBPS_TARGET" = "extract" ] && exit 0
 
 # Run patch phrase
-$XBPS_LIBEXECDIR/xbps-src-dopatch.sh $SOURCEPKG $XBPS_CROSS_BUILD || exit 1
+run_phase patch $XBPS_LIBEXECDIR/xbps-src-dopatch.sh $SOURCEPKG $XBPS_CROSS_BUILD
 [ "$XBPS_TARGET" = "patch" ] && exit 0
 
 # Run configure phase
-$XBPS_LIBEXECDIR/xbps-src-doconfigure.sh $SOURCEPKG $XBPS_CROSS_BUILD || exit 1
+run_phase configure $XBPS_LIBEXECDIR/xbps-src-doconfigure.sh $SOURCEPKG $XBPS_CROSS_BUILD
 [ "$XBPS_TARGET" = "configure" ] && exit 0
 
 # Run build phase
-$XBPS_LIBEXECDIR/xbps-src-dobuild.sh $SOURCEPKG $XBPS_CROSS_BUILD || exit 1
+run_phase build $XBPS_LIBEXECDIR/xbps-src-dobuild.sh $SOURCEPKG $XBPS_CROSS_BUILD
 [ "$XBPS_TARGET" = "build" ] && exit 0
 
 # Run check phase
-$XBPS_LIBEXECDIR/xbps-src-docheck.sh $SOURCEPKG $XBPS_CROSS_BUILD || exit 1
+run_phase check $XBPS_LIBEXECDIR/xbps-src-docheck.sh $SOURCEPKG $XBPS_CROSS_BUILD
 [ "$XBPS_TARGET" = "check" ] && exit 0
 
 # Install pkgs into destdir.
-$XBPS_LIBEXECDIR/xbps-src-doinstall.sh $SOURCEPKG no $XBPS_CROSS_BUILD || exit 1
+run_phase install $XBPS_LIBEXECDIR/xbps-src-doinstall.sh $SOURCEPKG no $XBPS_CROSS_BUILD
 
 for subpkg in ${subpackages} ${sourcepkg}; do
-    $XBPS_LIBEXECDIR/xbps-src-doinstall.sh $subpkg yes $XBPS_CROSS_BUILD || exit 1
+    run_phase install $XBPS_LIBEXECDIR/xbps-src-doinstall.sh $subpkg yes $XBPS_CROSS_BUILD
 done
 for subpkg in ${subpackages} ${sourcepkg}; do
-    $XBPS_LIBEXECDIR/xbps-src-prepkg.sh $subpkg $XBPS_CROSS_BUILD || exit 1
+    run_phase prepkg $XBPS_LIBEXECDIR/xbps-src-prepkg.sh $subpkg $XBPS_CROSS_BUILD
 done
 
 for subpkg in ${subpackages} ${sourcepkg}; do
@@ -97,44 +156,13 @@ done
 printf "" > ${XBPS_STATEDIR}/.${sourcepkg}_register_pkg
 # If install went ok generate the binpkgs.
 for subpkg in ${subpackages} ${sourcepkg}; do
-    $XBPS_LIBEXECDIR/xbps-src-dopkg.sh $subpkg "$XBPS_REPOSITORY" "$XBPS_CROSS_BUILD" || exit 1
+    run_phase pkg $XBPS_LIBEXECDIR/xbps-src-dopkg.sh $subpkg "$XBPS_REPOSITORY" "$XBPS_CROSS_BUILD"
 done
 
-# Registering packages at once per repository. This makes sure that staging is
-# triggered for all new packages if any of them introduces inconsistencies.
-cut -d: -f 1,2 ${XBPS_STATEDIR}/.${sourcepkg}_register_pkg | sort -u | \
-    while IFS=: read -r arch repo; do
-        paths=$(grep "^$arch:$repo:" "${XBPS_STATEDIR}/.${sourcepkg}_register_pkg" | \
-            cut -d : -f 2,3 | tr ':' '/')
-        if [ -z "$XBPS_PRESERVE_PKGS" ] || [ "$XBPS_BUILD_FORCEMODE" ]; then
-            force=-f
-        fi
-        if [ -n "${arch}" ]; then
-            msg_normal "Registering new packages to $repo ($arch)\n"
-            XBPS_TARGET_ARCH=${arch} $XBPS_RINDEX_CMD \
-                ${XBPS_REPO_COMPTYPE:+--compression $XBPS_REPO_COMPTYPE} ${force} -a ${paths}
-        else
-            msg_normal "Registering new packages to $repo\n"
-            if [ -n "$XBPS_CROSS_BUILD" ]; then
-                $XBPS_RINDEX_XCMD ${XBPS_REPO_COMPTYPE:+--compression $XBPS_REPO_COMPTYPE} \
-					${force} -a ${paths}
-            else
-                $XBPS_RINDEX_CMD ${XBPS_REPO_COMPTYPE:+--compression $XBPS_REPO_COMPTYPE} \
-					${force} -a ${paths}
-            fi
-        fi
-    done
-
-# pkg cleanup
-if declare -f do_clean >/dev/null; then
-    run_func do_clean
-fi
-
-if [ -n "$XBPS_DEPENDENCY" -o -z "$XBPS_KEEP_ALL" ]; then
-    remove_pkg_autodeps
-    remove_pkg_wrksrc
-    remove_pkg $XBPS_CROSS_BUILD
-    remove_pkg_statedir
-fi
+register_pkgs || exit $?
+build_times_save $sourcepkg "$phase_times"
+telemetry_save
+[ -n "$build_cache_key" ] && build_cache_save $build_cache_key
+pkg_cleanup
 
 exit 0
@@ -30,6 +30,10 @@ if [ -f $XBPS_EXTRACT_DONE ]; then
     exit 0
 fi
 
+# Nothing but the do-extract hook may read distfiles left unverified by
+# do-fetch.
+distfiles_extracted_by_hook || distfiles_verify_unverified
+
 # Run pre-extract hooks
 run_pkg_hooks pre-extract
 
@@ -59,6 +63,8 @@ else
     fi
 fi
 
+# Verify the distfiles left to do-extract that were not extracted by it.
+distfiles_verify_unverified
 
 [ -d "$wrksrc" ] && cd "$wrksrc"
 
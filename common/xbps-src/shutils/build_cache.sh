@@ -0,0 +1,100 @@
+# vim: set ts=4 sw=4 et:
+#
+# Cache of built packages, keyed by a hash of everything going into a build:
+# the template with its files/ and patches/, xbps-src itself and the common/
+# scripts used by the template, the exact versions of the installed build
+# dependencies, the build and cross profiles, the compiler flags and the
+# build options. A hit copies the binpkgs into the local repository instead
+# of building them again.
+#
+# XBPS_BUILD_CACHE=yes keeps the cache in hostdir/build-cache, any other value
+# is the path of the cache, which may be shared by several builders. An entry
+# <cache>/<key>/ holds the binpkgs and "register", the lines of the register
+# list of build.sh with the repository relative to XBPS_REPOSITORY.
+
+build_cache_dir() {
+    case "$XBPS_BUILD_CACHE" in
+        "") return 1;;
+        yes) echo "$XBPS_HOSTDIR/build-cache";;
+        *) echo "$XBPS_BUILD_CACHE";;
+    esac
+}
+
+# Print the key of $sourcepkg, once its build dependencies are installed.
+build_cache_key() {
+    local f key
+
+    key=$( (
+        echo "$XBPS_SRC_VERSION $XBPS_TARGET_MACHINE $XBPS_CROSS_BUILD"
+        echo "$PKG_BUILD_OPTIONS"
+        echo "$XBPS_DEBUG_PKGS:$XBPS_DEBUG_DWZ:$XBPS_DEBUG_COMPTYPE"
+        echo "$XBPS_CHECK_PKGS:$XBPS_PKG_COMPTYPE:$XBPS_BUILD_ENVIRONMENT"
+        [ -n "$XBPS_USE_GIT_REVS" ] && echo "$XBPS_GIT_REVS"
+        echo "$CFLAGS:$CXXFLAGS:$FFLAGS:$CPPFLAGS:$LDFLAGS"
+        cd $XBPS_SRCPKGDIR/$sourcepkg &&
+            find . -type f | LC_ALL=C sort | xargs -r -d '\n' sha256sum
+        cd $XBPS_COMMONDIR && {
+            find environment hooks xbps-src -type f
+            for f in ../xbps-src build-style/${build_style}.sh \
+                build-profiles/bootstrap.sh build-profiles/${XBPS_MACHINE}.sh \
+                cross-profiles/${XBPS_CROSS_BUILD}.sh shlibs; do
+                [ -f $f ] && echo $f
+            done
+            for f in ${build_helper}; do
+                echo build-helper/$f.sh
+            done
+        } | LC_ALL=C sort | xargs -r -d '\n' sha256sum
+        $XBPS_QUERY_CMD -l | awk '{ print $2 }' | LC_ALL=C sort
+        if [ -n "$XBPS_CROSS_BUILD" ]; then
+            $XBPS_QUERY_XCMD -l | awk '{ print $2 }' | LC_ALL=C sort
+        fi
+    ) 2>/dev/null | sha256sum)
+    echo "${key%% *}"
+}
+
+# Copy the binpkgs of the entry $1 into the local repository and add them
+# to the register list; fails if there is no such entry.
+build_cache_restore() {
+    local dir arch repo binpkg reglist="${XBPS_STATEDIR}/.${sourcepkg}_register_pkg"
+
+    dir=$(build_cache_dir)/$1
+    [ -f $dir/register ] || return 1
+
+    msg_normal "$pkgver: found in the build cache ($1), skipping build.\n"
+    printf "" > $reglist
+    while IFS=: read -r arch repo binpkg; do
+        mkdir -p ${XBPS_REPOSITORY}${repo}
+        if ! ln -f $dir/$binpkg ${XBPS_REPOSITORY}${repo}/$binpkg 2>/dev/null &&
+            ! cp -f $dir/$binpkg ${XBPS_REPOSITORY}${repo}/$binpkg; then
+            msg_error "$pkgver: failed to copy $binpkg from the build cache.\n"
+        fi
+        printf "%s:%s:%s\n" "$arch" "${XBPS_REPOSITORY}${repo}" "$binpkg" >> $reglist
+    done < $dir/register
+    touch $dir
+}
+
+# Store the binpkgs in the register list as the entry $1.
+build_cache_save() {
+    local cache dir tmpdir arch repo binpkg reglist="${XBPS_STATEDIR}/.${sourcepkg}_register_pkg"
+
+    cache=$(build_cache_dir) || return 0
+    dir=$cache/$1
+    [ -d $dir -o ! -s $reglist ] && return 0
+
+    mkdir -p $cache && tmpdir=$(mktemp -d $cache/.$1.XXXXXXXX) || {
+        msg_warn "$pkgver: cannot write to the build cache $cache.\n"
+        return 0
+    }
+    while IFS=: read -r arch repo binpkg; do
+        if ! ln -f $repo/$binpkg $tmpdir/$binpkg 2>/dev/null &&
+            ! cp -f $repo/$binpkg $tmpdir/$binpkg; then
+            msg_warn "$pkgver: failed to add $binpkg to the build cache.\n"
+            rm -rf $tmpdir
+            return 0
+        fi
+        printf "%s:%s:%s\n" "$arch" "${repo#$XBPS_REPOSITORY}" "$binpkg" >> $tmpdir/register
+    done < $reglist
+    chmod 755 $tmpdir
+    # another builder may have stored the same entry meanwhile
+    mv -T $tmpdir $dir 2>/dev/null || rm -rf $tmpdir
+}
@@ -0,0 +1,24 @@
+# vim: set ts=4 sw=4 et:
+#
+# Build time history: hostdir/build-times/<arch>/<sourcepkg> holds one
+# "<phase> <seconds>" line per phase of the last successful build.
+
+build_times_file() {
+    echo "$XBPS_HOSTDIR/build-times/${XBPS_CROSS_BUILD:-$XBPS_MACHINE}/$1"
+}
+
+# Store the phase times passed as a string of "<phase> <seconds>" lines.
+build_times_save() {
+    local f=$(build_times_file "$1") tmpf
+
+    mkdir -p "${f%/*}" || return 1
+    tmpf=$(mktemp "$f.XXXXXXXX") || return 1
+    printf "%b" "$2" > "$tmpf" && mv -f "$tmpf" "$f"
+}
+
+# Print the total build time in seconds, or nothing if it is unknown.
+build_times_get() {
+    local f=$(build_times_file "$1")
+
+    [ -r "$f" ] && awk '{ t += $2 } END { print t }' "$f"
+}
@@ -10,8 +10,8 @@ bulk_getlink() {
     echo $p
 }
 
-bulk_sortdeps() {
-    local _pkgs _pkg pkgs pkg found f x tmpf
+bulk_depgraph() {
+    local _pkgs _pkg pkgs pkg found f x
 
     _pkgs="$@"
     # Iterate over the list and make sure that only real pkgs are
@@ -30,12 +30,13 @@ bulk_sortdeps() {
         fi
     done
 
-    tmpf=$(mktemp) || exit 1
-    # Now make the real dependency graph of all pkgs to build.
-    # Perform a topological sort of all pkgs but only with build dependencies
-    # that are found in previous step.
+    # Now make the real dependency graph of all pkgs to build, one
+    # "pkg dep" pair per line, but only with build dependencies that
+    # are found in previous step. Pkgs without such dependencies are
+    # printed as "pkg pkg".
+    template_index_update ${pkgs}
     for pkg in ${pkgs}; do
-        _pkgs="$($XBPS_DISTDIR/xbps-src show-build-deps $pkg 2>/dev/null)"
+        _pkgs="$(template_index_load $pkg && template_index_deps && echo $build_deps)"
         found=0
         for x in ${_pkgs}; do
             _pkg=$(bulk_getlink $x)
@@ -44,19 +45,34 @@ bulk_sortdeps() {
                     continue
                 fi
                 found=1
-                echo "${pkg} ${f}" >> $tmpf
+                echo "${pkg} ${f}"
             done
         done
-        [ $found -eq 0 ] && echo "${pkg} ${pkg}" >> $tmpf
+        [ $found -eq 0 ] && echo "${pkg} ${pkg}"
     done
+}
+
+bulk_sortdeps() {
+    local tmpf
+
+    tmpf=$(mktemp) || exit 1
+    # Perform a topological sort of all pkgs.
+    bulk_depgraph "$@" > $tmpf
     tsort $tmpf|tac
     rm -f $tmpf
 }
 
+# Print the pkg if it can be built for the target arch; runs as a job
+# of run_jobs().
+bulk_avail() {
+    template_index_load $1 && template_index_buildable || return 0
+    if show_avail &>/dev/null; then
+        echo "$1"
+    fi
+}
+
 bulk_build() {
-    local sys="$1"
-    local NPROCS=$(($(nproc)*2))
-    local NRUNNING=0
+    local sys="$1" pkgs f
 
     if [ "$XBPS_CROSS_BUILD" ]; then
         source ${XBPS_COMMONDIR}/cross-profiles/${XBPS_CROSS_BUILD}.sh
@@ -72,25 +88,156 @@ bulk_build() {
         return $?
     fi
     # compare repo pkg versions vs srcpkgs
-    for f in $(xbps-checkvers -f '%n' -D $XBPS_DISTDIR); do
-        if [ $NRUNNING -eq $NPROCS ]; then
-            NRUNNING=0
-            wait
+    pkgs=$(xbps-checkvers -f '%n' -D $XBPS_DISTDIR)
+    template_index_update ${pkgs}
+    run_jobs $(($(nproc)*2)) bulk_avail ${pkgs}
+    return 0
+}
+
+bulk_build_pkg() {
+    local pkg="$1"
+
+    if [ -n "$CHROOT_READY" -a -z "$IN_CHROOT" ]; then
+        chroot_handler pkg $pkg
+    else
+        $XBPS_LIBEXECDIR/build.sh $pkg $pkg pkg $XBPS_CROSS_BUILD
+    fi
+}
+
+bulk_eta() {
+    local jobs="$1" pkg crit=0 work=0 n=0
+    shift
+
+    for pkg; do
+        [ ${prio[$pkg]} -gt $crit ] && crit=${prio[$pkg]}
+        work=$((work+est[$pkg]))
+        n=$((n+1))
+    done
+    [ $n -gt 0 ] || return 0
+    [ $((work/jobs)) -gt $crit ] && crit=$((work/jobs))
+    msg_normal "xbps-src: $n package(s) left, predicted finish at $(date -d @$((EPOCHSECONDS+crit)) '+%F %T')\n"
+}
+
+bulk_schedule() {
+    local jobs="$1" logdir="$2" edges pkg dep pid rval blocked ready nrunning=0
+    local known=0 total=0 t i
+    local -A deps rdeps state pids cause est prio
+    local -a order
+    shift 2
+
+    # Build every pkg as soon as all of its build dependencies in the
+    # list have been built and registered, running up to $jobs builds
+    # at once. Pkgs depending on a failed build are skipped, everything
+    # else is built regardless.
+    edges="$(bulk_depgraph "$@")"
+    while read -r pkg dep; do
+        state[$pkg]=pending
+        if [ "$pkg" != "$dep" ]; then
+            deps[$pkg]+="$dep "
+            rdeps[$dep]+="$pkg "
         fi
-        NRUNNING=$((NRUNNING+1))
-        (
-            setup_pkg $f $XBPS_TARGET_MACHINE &>/dev/null
-            if show_avail &>/dev/null; then
-                echo "$f"
+    done <<< "$edges"
+    order=($(tsort <<< "$edges" 2>/dev/null | tac))
+
+    # Among the pkgs that are ready, start the ones on the longest
+    # remaining chain of builds first. Build times come from the
+    # history kept by build.sh; pkgs never built before are assumed
+    # to take the average time.
+    for pkg in "${order[@]}"; do
+        t=$(build_times_get $pkg)
+        [ -n "$t" ] || continue
+        est[$pkg]=$t
+        known=$((known+1))
+        total=$((total+t))
+    done
+    [ $known -gt 0 ] && t=$((total/known)) || t=300
+    for ((i = ${#order[@]} - 1; i >= 0; i--)); do
+        pkg=${order[$i]}
+        : ${est[$pkg]:=$t}
+        [ ${est[$pkg]} -gt 0 ] || est[$pkg]=1
+        prio[$pkg]=0
+        for dep in ${rdeps[$pkg]}; do
+            [ ${prio[$dep]:-0} -gt ${prio[$pkg]} ] && prio[$pkg]=${prio[$dep]}
+        done
+        prio[$pkg]=$((prio[$pkg]+est[$pkg]))
+    done
+    # a pkg always has a higher priority than its reverse dependencies,
+    # so this is still a topological order.
+    order=($(for pkg in "${order[@]}"; do
+        echo "${prio[$pkg]} $pkg"
+    done | sort -k1,1nr -k2,2 | cut -d' ' -f2))
+    bulk_eta $jobs "${order[@]}"
+
+    while :; do
+        for pkg in "${order[@]}"; do
+            [ "${state[$pkg]}" = pending ] || continue
+            blocked= ready=1
+            for dep in ${deps[$pkg]}; do
+                case "${state[$dep]}" in
+                    built) ;;
+                    failed|skipped) blocked=$dep; break;;
+                    *) ready=;;
+                esac
+            done
+            if [ -n "$blocked" ]; then
+                state[$pkg]=skipped
+                cause[$pkg]=$blocked
+                msg_warn "xbps-src: skipping $pkg, depends on ${state[$blocked]} $blocked\n"
+                continue
+            fi
+            [ -n "$ready" -a $nrunning -lt $jobs ] || continue
+            msg_normal "xbps-src: building $pkg ...\n"
+            if [ -n "$logdir" ]; then
+                bulk_build_pkg $pkg >$logdir/$pkg.log 2>&1 &
+            else
+                bulk_build_pkg $pkg &
             fi
-        ) &
+            state[$pkg]=running
+            pids[$!]=$pkg
+            nrunning=$((nrunning+1))
+        done
+        [ $nrunning -eq 0 ] && break
+
+        wait -n -p pid
+        rval=$?
+        pkg=${pids[$pid]}
+        [ -n "$pkg" ] || continue
+        unset pids[$pid]
+        nrunning=$((nrunning-1))
+        if [ $rval -eq 0 ]; then
+            state[$pkg]=built
+        else
+            state[$pkg]=failed
+            msg_red "xbps-src: failed to build $pkg${logdir:+, see $logdir/$pkg.log}\n"
+        fi
+        bulk_eta $jobs $(for pkg in "${order[@]}"; do
+            case "${state[$pkg]}" in
+                pending|running) echo $pkg;;
+            esac
+        done)
     done
-    wait
-    return $?
+
+    # Whatever is still pending is part of a dependency cycle.
+    bulk_built= bulk_failed= bulk_skipped=
+    for pkg in "${order[@]}"; do
+        case "${state[$pkg]}" in
+            built) bulk_built+="$pkg ";;
+            failed) bulk_failed+="$pkg ";;
+            skipped) bulk_skipped+="$pkg (${cause[$pkg]}) ";;
+            *) bulk_skipped+="$pkg (cycle) ";;
+        esac
+    done
+
+    echo
+    msg_normal "xbps-src: bulk build finished:\n"
+    echo " built:   ${bulk_built:-none}"
+    echo " failed:  ${bulk_failed:-none}"
+    echo " skipped: ${bulk_skipped:-none}"
+    [ -z "$bulk_failed" -a -z "$bulk_skipped" ]
 }
 
 bulk_update() {
-    local args="$1" pkgs f rval
+    local args="$1" jobs=${XBPS_BULK_JOBS:-1} logdir pkgs f rval
 
     pkgs="$(bulk_build ${args})"
     [[ -z $pkgs ]] && return 0
@@ -99,22 +246,35 @@ bulk_update() {
     for f in ${pkgs}; do
         echo " $f"
     done
-    for f in ${pkgs}; do
-        XBPS_TARGET_PKG=$f
-        read_pkg
-        msg_normal "xbps-src: building ${pkgver} ...\n"
-        if [ -n "$CHROOT_READY" -a -z "$IN_CHROOT" ]; then
-            chroot_handler pkg $XBPS_TARGET_PKG
+    if [ "$jobs" -gt 1 ]; then
+        if [ -z "$CHROOT_READY" -o -n "$IN_CHROOT" ]; then
+            # builds would share a single root and its installed deps.
+            msg_warn "xbps-src: XBPS_BULK_JOBS needs a chroot, building one package at a time\n"
+            jobs=1
         else
-            $XBPS_LIBEXECDIR/build.sh $f $f pkg $XBPS_CROSS_BUILD
-        fi
-        if [ $? -eq 1 ]; then
-            msg_error "xbps-src: failed to build $pkgver pkg!\n"
+            # give each build its own temporary masterdir.
+            if [ -z "$XBPS_TEMP_MASTERDIR" ]; then
+                export XBPS_CHROOT_CMD="uchroot"
+                export XBPS_CHROOT_CMD_ARGS+=" -O"
+            fi
+            logdir=$XBPS_HOSTDIR/bulk-logs
+            mkdir -p $logdir || return 1
+            # the masterdir is the lower dir of the running builds, set
+            # it up now rather than from every job.
+            mkdir -p $XBPS_MASTERDIR/void-packages &&
+                chroot_prepare && chroot_init || return 1
+            _chroot_initialized=1
         fi
-    done
-    if [ -n "$pkgs" -a -n "$args" ]; then
+    fi
+    # all jobs share the jobserver, held until the bulk build is done.
+    jobserver_join
+    bulk_schedule $jobs "$logdir" ${pkgs}
+    rval=$?
+    telemetry_report ${bulk_built}
+    if [ -n "$bulk_built" -a -n "$args" ]; then
         echo
         msg_normal "xbps-src: updating your system, confirm to proceed...\n"
-        ${XBPS_SUCMD} "xbps-install --repository=$XBPS_REPOSITORY --repository=$XBPS_REPOSITORY/nonfree -u ${pkgs//[$'\n']/ }" || return 1
+        ${XBPS_SUCMD} "xbps-install --repository=$XBPS_REPOSITORY --repository=$XBPS_REPOSITORY/nonfree -u ${bulk_built}" || return 1
     fi
+    return $rval
 }
@@ -140,7 +140,7 @@ chroot_prepare() {
 }
 
 chroot_handler() {
-    local action="$1" pkg="$2" rv=0 arg= _envargs=
+    local action="$1" pkg="$2" rv=0 arg= _envargs= root="$XBPS_MASTERDIR"
 
     [ -z "$action" -a -z "$pkg" ] && return 1
 
@@ -151,18 +151,27 @@ chroot_handler() {
         mkdir -p $XBPS_MASTERDIR/void-packages
     fi
 
-    case "$action" in
-        fetch|extract|patch|configure|build|check|install|pkg|bootstrap-update|chroot|clean)
-            chroot_prepare || return $?
-            chroot_init || return $?
-            ;;
-    esac
+    # bulk builds initialize the masterdir once, before starting their
+    # jobs; it must not be rewritten while other jobs are using it.
+    if [ -z "$_chroot_initialized" ]; then
+        case "$action" in
+            fetch|extract|patch|configure|build|check|install|pkg|bootstrap-update|chroot|clean)
+                chroot_prepare || return $?
+                chroot_init || return $?
+                ;;
+        esac
+    fi
 
     if [ "$action" = "chroot" ]; then
         $XBPS_COMMONDIR/chroot-style/${XBPS_CHROOT_CMD:=uunshare}.sh \
             $XBPS_MASTERDIR $XBPS_DISTDIR "$XBPS_HOSTDIR" "$XBPS_CHROOT_CMD_ARGS" /bin/xbps-shell
         rv=$?
     else
+        if [ "$action" = "pkg" -a -n "$XBPS_CHROOT_SNAPSHOTS" -a \
+            -z "$XBPS_KEEP_ALL" -a -z "$XBPS_CROSS_BUILD" ] &&
+            snapshot_prepare $pkg; then
+            root="$_snapshot_root"
+        fi
         env -i -- PATH="/usr/bin:$PATH" SHELL=/bin/sh \
             HOME=/tmp IN_CHROOT=1 LC_COLLATE=C LANG=en_US.UTF-8 \
             ${HTTP_PROXY:+HTTP_PROXY="${HTTP_PROXY}"} \
@@ -176,10 +185,12 @@ chroot_handler() {
             XBPS_GIT_REVS="$XBPS_GIT_REVS" \
             XBPS_ALLOW_CHROOT_BREAKOUT="$XBPS_ALLOW_CHROOT_BREAKOUT" \
             ${XBPS_ALT_REPOSITORY:+XBPS_ALT_REPOSITORY=$XBPS_ALT_REPOSITORY} \
+            ${_snapshot_root:+XBPS_CHROOT_SNAPSHOT=1} \
             $XBPS_COMMONDIR/chroot-style/${XBPS_CHROOT_CMD:=uunshare}.sh \
-            $XBPS_MASTERDIR $XBPS_DISTDIR "$XBPS_HOSTDIR" "$XBPS_CHROOT_CMD_ARGS" \
+            $root $XBPS_DISTDIR "$XBPS_HOSTDIR" "$XBPS_CHROOT_CMD_ARGS" \
             /void-packages/xbps-src $XBPS_OPTIONS $action $pkg
         rv=$?
+        snapshot_drop
     fi
 
     return $rv
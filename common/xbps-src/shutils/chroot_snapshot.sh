@@ -0,0 +1,167 @@
+# vim: set ts=4 sw=4 et:
+#
+# Snapshots of the masterdir with the build dependencies of a package
+# installed, used by chroot_handler() when XBPS_CHROOT_SNAPSHOTS is set.
+#
+# A snapshot is kept per set of dependencies in hostdir/snapshots/<key>,
+# <key> being a hash of the xbps-install(1) transaction installing them
+# into the masterdir, so that it changes with the masterdir and with the
+# versions in the repositories. A package is then built in a throwaway
+# root on top of its snapshot, which is dropped instead of removing the
+# autodeps:
+#
+#   overlay  the snapshot holds the upper dir of an overlayfs(5) mount
+#            on the masterdir; the root is another overlayfs(5) mount
+#            with the snapshot and the masterdir as lower dirs. This
+#            requires root.
+#   reflink  the snapshot is a copy of the masterdir and the root is a
+#            copy of the snapshot, made with reflinks on filesystems
+#            supporting them (btrfs, xfs); plain copies elsewhere.
+#
+# Snapshots not used for a week are removed.
+
+# Print the build dependencies of pkg $1, as passed to xbps-install(1).
+snapshot_deps() {
+    (
+        template_index_load $1 && template_index_deps || exit 1
+        for f in ${hostmakedepends} ${makedepends} \
+            $([ -n "$XBPS_CHECK_PKGS" ] && echo ${checkdepends}); do
+            if [[ $f == virtual\?* ]]; then
+                f=${f#*\?}
+                vfile=${XBPS_DISTDIR}/etc/virtual
+                [ -s $vfile ] || vfile=${XBPS_DISTDIR}/etc/defaults.virtual
+                f=$(awk -v p="${f%%[<>=]*}" '$1 == p { print $2; exit }' $vfile)
+                [ -n "$f" ] || exit 1
+            fi
+            echo "$f"
+        done
+    )
+}
+
+# Run xbps-install(1) on the host for the root $1, with the repositories of
+# the masterdir.
+snapshot_xbps_install() {
+    local root="$1" confdir f rv
+    shift
+
+    confdir=$(mktemp -d) || return 1
+    for f in $XBPS_MASTERDIR/etc/xbps.d/*.conf; do
+        [ -e "$f" ] || continue
+        sed -e "s,=/host/,=$XBPS_HOSTDIR/,g" "$f" > $confdir/${f##*/}
+    done
+    xbps-install -r $root -C $confdir -c $XBPS_HOSTDIR/repocache-$XBPS_MACHINE "$@"
+    rv=$?
+    rm -rf $confdir
+    return $rv
+}
+
+snapshot_key() {
+    local trans rv
+
+    trans=$(snapshot_xbps_install $XBPS_MASTERDIR -n "$@" 2>/dev/null)
+    rv=$?
+    # 6 (EEXIST): all already installed
+    [ $rv -eq 0 -o $rv -eq 6 ] || return 1
+    trans=$( {
+        echo "$XBPS_MACHINE:$XBPS_CHECK_PKGS:$XBPS_CHROOT_SNAPSHOTS"
+        echo "$trans" | awk '{ print $1, $2 }' | LC_ALL=C sort
+        cat $XBPS_MASTERDIR/var/db/xbps/pkgdb-*.plist
+    } | sha256sum)
+    echo "${trans%% *}"
+}
+
+# Copy the root $1 into the new dir $2, leaving out the build dirs.
+snapshot_copy() {
+    local f
+
+    mkdir -p "$2" || return 1
+    for f in "$1"/* "$1"/.[!.]*; do
+        [ -e "$f" ] || continue
+        case "${f##*/}" in
+            builddir|destdir) mkdir -p "$2/${f##*/}";;
+            *) cp -a --reflink=auto "$f" "$2/" || return 1;;
+        esac
+    done
+}
+
+# Create the snapshot $1 with the pkgs $2... installed.
+snapshot_create() {
+    local snap="$1" tmp rv
+    shift
+
+    tmp=$(mktemp -d $snap.XXXXXXXX) || return 1
+    case "$XBPS_CHROOT_SNAPSHOTS" in
+        overlay)
+            mkdir -p $tmp/upper $tmp/work $tmp/root &&
+                mount -t overlay overlay \
+                    -o lowerdir=$XBPS_MASTERDIR,upperdir=$tmp/upper,workdir=$tmp/work \
+                    $tmp/root || { rm -rf $tmp; return 1; }
+            snapshot_xbps_install $tmp/root -Ay "$@" >/dev/null
+            rv=$?
+            umount $tmp/root
+            rm -rf $tmp/work $tmp/root
+            ;;
+        *)
+            snapshot_copy $XBPS_MASTERDIR $tmp/root &&
+                snapshot_xbps_install $tmp/root -Ay "$@" >/dev/null
+            rv=$?
+            ;;
+    esac
+    [ $rv -eq 0 -o $rv -eq 6 ] && mv -T $tmp $snap 2>/dev/null
+    rm -rf $tmp
+    [ -d $snap ]
+}
+
+# Set up a build root for pkg $1 on top of its snapshot, creating the
+# snapshot if needed, and set _snapshot_root to the root. Fails if there is
+# no usable snapshot; the pkg is then built in the masterdir as usual.
+snapshot_prepare() {
+    local pkg="$1" snapdir="$XBPS_HOSTDIR/snapshots" key snap tmp deps
+
+    _snapshot_root=
+    if [ "$XBPS_CHROOT_SNAPSHOTS" = "overlay" -a $(id -u) -ne 0 ]; then
+        msg_warn "xbps-src: overlay snapshots require root, building in $XBPS_MASTERDIR.\n"
+        return 1
+    fi
+    deps=$(snapshot_deps $pkg) && key=$(snapshot_key $deps) || return 1
+    snap=$snapdir/$key
+
+    mkdir -p $snapdir || return 1
+    if [ ! -d $snap ]; then
+        find $snapdir -mindepth 1 -maxdepth 1 -type d ! -name '.*' -mtime +7 \
+            -exec rm -rf {} + 2>/dev/null
+        msg_normal "$pkg: creating snapshot of build dependencies ${key:0:16}...\n"
+        snapshot_create $snap $deps || return 1
+    fi
+    touch $snap
+
+    tmp=$(mktemp -d $snapdir/.build.XXXXXXXX) || return 1
+    case "$XBPS_CHROOT_SNAPSHOTS" in
+        overlay)
+            mkdir -p $tmp/upper $tmp/work $tmp/root &&
+                mount -t overlay overlay \
+                    -o lowerdir=$snap/upper:$XBPS_MASTERDIR,upperdir=$tmp/upper,workdir=$tmp/work \
+                    $tmp/root || { rm -rf $tmp; return 1; }
+            ;;
+        *)
+            snapshot_copy $snap/root $tmp/root || { rm -rf $tmp; return 1; }
+            ;;
+    esac
+    msg_normal "$pkg: building on snapshot ${key:0:16}.\n"
+    _snapshot_root=$tmp/root
+}
+
+# Drop the build root set up by snapshot_prepare().
+snapshot_drop() {
+    local tmp="${_snapshot_root%/root}"
+
+    [ -n "$_snapshot_root" ] || return 0
+    if [ "$XBPS_CHROOT_SNAPSHOTS" = "overlay" ]; then
+        umount $_snapshot_root
+    else
+        # Needed to remove Go Modules
+        chmod -R +wX $_snapshot_root/builddir 2>/dev/null
+    fi
+    rm -rf $tmp
+    _snapshot_root=
+}
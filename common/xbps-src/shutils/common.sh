@@ -10,6 +10,7 @@ run_func() {
 
     msg_normal "${pkgver:-xbps-src}: running ${desc:-${func}} ...\n"
 
+    telemetry_begin
     set -E
     restoretrap=$(trap -p ERR)
     trap 'error_func $funcname $LINENO' ERR
@@ -25,6 +26,46 @@ run_func() {
 
     eval "$restoretrap"
     set +E
+    telemetry_end $([ "$func" = hook ] && echo hook || echo func) $funcname
+}
+
+# Runs "$func <arg>" for every remaining argument, keeping up to $jobs of
+# them running at once: a new job starts as soon as any job finishes.
+# Each argument is split on whitespace, so a job can take several.
+# The output of the jobs is printed in the order of the arguments, as
+# soon as all earlier jobs are done. Returns 1 if any job failed.
+run_jobs() {
+    local jobs="$1" func="$2" outdir arg pid i=0 next=0 rv=0
+    local -A running finished
+    shift 2
+
+    outdir=$(mktemp -d) || return 1
+    for arg; do
+        while [ ${#running[@]} -ge $jobs ]; do
+            wait -n -p pid "${!running[@]}" || rv=1
+            finished[${running[$pid]}]=1
+            unset running[$pid]
+            while [ -n "${finished[$next]}" ]; do
+                cat $outdir/$next
+                rm -f $outdir/$next
+                next=$((next+1))
+            done
+        done
+        $func $arg > $outdir/$i &
+        running[$!]=$i
+        i=$((i+1))
+    done
+    while [ ${#running[@]} -gt 0 ]; do
+        wait -n -p pid "${!running[@]}" || rv=1
+        finished[${running[$pid]}]=1
+        unset running[$pid]
+    done
+    while [ $next -lt $i ]; do
+        cat $outdir/$next
+        next=$((next+1))
+    done
+    rm -rf $outdir
+    return $rv
 }
 
 ch_wrksrc() {
@@ -82,6 +123,12 @@ run_step() {
   fi
 }
 
+# Add the command $1 to the EXIT trap, run before the commands already there.
+exit_trap_add() {
+    eval "set -- \"\$1\" $(trap -p EXIT)"
+    trap "$1${4:+; $4}" EXIT
+}
+
 error_func() {
     local err=$?
     local src=
@@ -237,6 +284,9 @@ run_pkg_hooks() {
     local phase="$1" hookn f
 
     eval unset -f hook
+    case "$phase" in
+        post-install|pre-pkg) destdir_files_init;;
+    esac
     for f in ${XBPS_COMMONDIR}/hooks/${phase}/*.sh; do
         [ ! -r $f ] && continue
         hookn=${f##*/}
@@ -244,6 +294,7 @@ run_pkg_hooks() {
         . $f
         run_func hook "$phase hook: $hookn" ${phase}_${hookn}
     done
+    destdir_files_clear
 }
 
 unset_package_funcs() {
@@ -54,8 +54,7 @@ consistency_check_smart () {
             continue
         fi
         (
-            XBPS_TARGET_PKG=$dep
-            read_pkg
+            template_index_load $dep && template_index_buildable || exit 0
             xbps-uhelper pkgmatch "$depdef" "${pkgname}-${version}_${revision}" && return
             msg_red "unsatisfied $deplabel in $origname: $dep is $version, but required is $depdef\n";
         )
@@ -64,11 +63,12 @@ consistency_check_smart () {
 
 consistency_check() {
     local pkg= pkgname=
+    template_index_update
     for pkg in "$XBPS_SRCPKGDIR"/*/template; do
         pkg=${pkg%/*}
         XBPS_TARGET_PKG=${pkg##*/}
         (
-            read_pkg
+            template_index_load $XBPS_TARGET_PKG && template_index_buildable || exit 0
             [ "$depends" ] && printf "%s $pkgname depends\n" $depends
             [ "$conflicts" ] && printf "%s $pkgname conflicts\n" $conflicts
             [ -L "$XBPS_SRCPKGDIR/$XBPS_TARGET_PKG" ] && return
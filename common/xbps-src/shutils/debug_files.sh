@@ -0,0 +1,29 @@
+# vim: set ts=4 sw=4 et:
+#
+# Helpers for the debug files of -dbg pkgs, see the post-install hooks
+# 06-strip-and-debug-pkgs and 07-dedup-debug-pkgs.
+
+# Returns 0 if the debug files are deduplicated with dwz(1). They are
+# then compressed and linked to the binaries after dwz(1) ran.
+debug_dwz_enabled() {
+    [ -n "$XBPS_DEBUG_DWZ" ] && command -v dwz >/dev/null
+}
+
+# Print the $OBJCOPY argument to compress debug sections as set by
+# XBPS_DEBUG_COMPTYPE; zstd falls back to zlib if $OBJCOPY lacks it.
+debug_compress_arg() {
+    case "$XBPS_DEBUG_COMPTYPE" in
+        none)
+            ;;
+        zstd)
+            if $OBJCOPY --help 2>&1 | grep -q zstd; then
+                echo "--compress-debug-sections=zstd"
+            else
+                echo "--compress-debug-sections=zlib"
+            fi
+            ;;
+        *)
+            echo "--compress-debug-sections"
+            ;;
+    esac
+}
@@ -0,0 +1,133 @@
+# vim: set ts=4 sw=4 et:
+#
+# Cache of the entries of PKGDESTDIR for the post-install and pre-pkg
+# hooks, so that PKGDESTDIR is walked once per phase instead of by every
+# hook. run_pkg_hooks() creates it before and drops it after these phases.
+# Hooks that add, remove, rename or chmod anything in PKGDESTDIR must pass
+# the changed paths to destdir_files_update().
+#
+# The cache holds a "<type> <mode> <path>" line per entry, <type> as
+# printed by find(1) -printf %y, <mode> in octal and <path> relative to
+# PKGDESTDIR; and the elf_scan() lines of its files once destdir_elf()
+# was used.
+
+destdir_files_init() {
+    destdir_files_clear
+    _destdir_files=$(mktemp -d) || exit 1
+    find "$PKGDESTDIR" -mindepth 1 -printf '%y\t%m\t%P\n' \
+        > $_destdir_files/files 2>/dev/null
+}
+
+destdir_files_clear() {
+    [ -n "$_destdir_files" ] && rm -rf $_destdir_files
+    _destdir_files=
+}
+
+# destdir_files [types] [regex] [mask]
+#
+# Print the paths of the entries of the given types (e.g. "f" or "fl",
+# all types if empty) whose path relative to PKGDESTDIR matches the
+# extended regex and which have any of the permission bits of the octal
+# mask set.
+destdir_files() {
+    [ -n "$_destdir_files" ] || destdir_files_init
+    # the regex is passed in the environment, -v would expand escapes.
+    _re="$2" awk -F '\t' -v types="$1" -v mask="$3" -v dir="$PKGDESTDIR" '
+        function anybits(mode, mask,    i, m, k, b) {
+            for (i = 0; i < 4; i++) {
+                m = int(mode / 10^i) % 10
+                k = int(mask / 10^i) % 10
+                for (b = 1; b <= 4; b *= 2)
+                    if (int(m / b) % 2 && int(k / b) % 2)
+                        return 1
+            }
+            return 0
+        }
+        (types == "" || index(types, $1)) &&
+        (ENVIRON["_re"] == "" || $3 ~ ENVIRON["_re"]) &&
+        (mask == "" || anybits($2, mask)) { print dir "/" $3 }' \
+        $_destdir_files/files
+}
+
+# destdir_elf [regex] [mask]
+#
+# Print the elf_scan() lines of the files selected as by destdir_files().
+destdir_elf() {
+    [ -n "$_destdir_files" ] || destdir_files_init
+    if [ ! -f $_destdir_files/elf ]; then
+        destdir_files f > $_destdir_files/elf.list
+        elf_scan_list $_destdir_files/elf.list > $_destdir_files/elf
+    fi
+    if [ -z "$1$2" ]; then
+        cat $_destdir_files/elf
+        return
+    fi
+    destdir_files f "$1" "$2" | \
+        awk -F '\t' 'NR == FNR { want[$0]; next } $1 in want' - $_destdir_files/elf
+}
+
+# destdir_files_update <path>...
+#
+# Refresh the entries of the given paths, absolute or relative to
+# PKGDESTDIR, and of everything below them.
+destdir_files_update() {
+    local f
+    local -a paths
+
+    [ -n "$_destdir_files" -a $# -gt 0 ] || return 0
+    for f; do
+        f=${f#$PKGDESTDIR}
+        f=${f#/}
+        [ -n "$f" ] && paths+=("$f")
+    done
+    [ ${#paths[@]} -gt 0 ] || return 0
+
+    printf "%s\n" "${paths[@]}" > $_destdir_files/changed
+    for f in files elf; do
+        [ -f $_destdir_files/$f ] || continue
+        awk -F '\t' -v col=$([ $f = files ] && echo 3 || echo 1) -v dir="$PKGDESTDIR" '
+            function gone(p) {
+                do {
+                    if (p in changed)
+                        return 1
+                } while (sub(/\/[^\/]*$/, "", p))
+                return 0
+            }
+            NR == FNR { changed[$0]; next }
+            !gone(col == 3 ? $3 : substr($1, length(dir) + 2))' \
+            $_destdir_files/changed $_destdir_files/$f > $_destdir_files/$f.new
+        mv -f $_destdir_files/$f.new $_destdir_files/$f
+    done
+
+    printf "%s\0" "${paths[@]}" | ( cd "$PKGDESTDIR" 2>/dev/null && \
+        xargs -0 sh -c 'find "$@" -printf "%y\t%m\t%p\n"' find 2>/dev/null ) \
+        > $_destdir_files/changed
+    cat $_destdir_files/changed >> $_destdir_files/files
+    if [ -f $_destdir_files/elf ]; then
+        awk -F '\t' -v dir="$PKGDESTDIR" '$1 == "f" { print dir "/" $3 }' \
+            $_destdir_files/changed > $_destdir_files/elf.list
+        elf_scan_list $_destdir_files/elf.list >> $_destdir_files/elf
+    fi
+    rm -f $_destdir_files/changed
+}
+
+# Remove the entries selected as by destdir_files().
+destdir_files_delete() {
+    local -a files
+
+    mapfile -t files < <(destdir_files "$@")
+    [ ${#files[@]} -gt 0 ] || return 0
+    rm -f "${files[@]}"
+    destdir_files_update "${files[@]}"
+}
+
+# Print the dirs that are empty or only contain such dirs, the deepest
+# first, as find(1) -empty -delete would remove them.
+destdir_empty_dirs() {
+    [ -n "$_destdir_files" ] || destdir_files_init
+    awk -F '\t' -v OFS='\t' '{ print gsub("/", "/", $3), $1, $3 }' \
+        $_destdir_files/files | sort -t "$(printf '\t')" -k1,1nr | \
+        awk -F '\t' -v dir="$PKGDESTDIR" '
+            $2 == "d" && !($3 in used) { print dir "/" $3; next }
+            { p = $3; if (sub(/\/[^\/]*$/, "", p)) used[p] = 1 }'
+}
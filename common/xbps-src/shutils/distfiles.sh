@@ -0,0 +1,259 @@
+# vim: set ts=4 sw=4 et:
+#
+# Helpers for the distfiles of a template, shared by the do-fetch and
+# do-extract hooks.
+#
+# With XBPS_DISTFILES_VERIFY_EXTRACT set, the do-fetch hook leaves the
+# checksums of the tarballs it extracts in the same build to the do-extract
+# hook, which hashes them while extracting them instead of reading (and
+# decompressing) them once more. These checksums are listed as
+# "<checksum> <distfile>" in the file printed by distfiles_unverified(),
+# distfiles_verify_unverified() checks any left after the do-extract phase.
+
+# Print the type of the distfile by its suffix: tar, txz, tbz, tlz, tgz,
+# tzst, crate, gz, xz, bz2, zst, zip, rpm, txt, 7z or gem.
+distfile_suffix() {
+    case $1 in
+    *.tar.lzma)   echo "txz";;
+    *.tar.lz)     echo "tlz";;
+    *.tlz)        echo "tlz";;
+    *.tar.xz)     echo "txz";;
+    *.txz)        echo "txz";;
+    *.tar.bz2)    echo "tbz";;
+    *.tbz)        echo "tbz";;
+    *.tar.gz)     echo "tgz";;
+    *.tgz)        echo "tgz";;
+    *.tar.zst)    echo "tzst";;
+    *.tzst)       echo "tzst";;
+    *.gz)         echo "gz";;
+    *.xz)         echo "xz";;
+    *.bz2)        echo "bz2";;
+    *.zst)        echo "zst";;
+    *.tar)        echo "tar";;
+    *.zip)        echo "zip";;
+    *.rpm)        echo "rpm";;
+    *.patch)      echo "txt";;
+    *.diff)       echo "txt";;
+    *.txt)        echo "txt";;
+    *.sh)         echo "txt";;
+    *.7z)         echo "7z";;
+    *.gem)        echo "gem";;
+    *.crate)      echo "crate";;
+    *) return 1;;
+    esac
+}
+
+# Print the command decompressing the tarball $1 from stdin to stdout
+# using all cores: pixz or xz -T0, lbzip2 or pbzip2, pigz, plzip or
+# zstd -T0; fails if none of them is available.
+distfile_parallel_decompress_cmd() {
+    local cmd
+
+    case $(distfile_suffix "$1") in
+    txz)
+        # pixz doesn't read the lzma format
+        if [[ $1 != *.lzma ]] && command -v pixz >/dev/null; then
+            cmd="pixz -d"
+        elif xz -T0 --version >/dev/null 2>&1; then
+            cmd="xz -T0 -dc"
+        fi
+        ;;
+    tbz)
+        if command -v lbzip2 >/dev/null; then
+            cmd="lbzip2 -dc"
+        elif command -v pbzip2 >/dev/null; then
+            cmd="pbzip2 -dc"
+        fi
+        ;;
+    tgz|crate)
+        command -v pigz >/dev/null && cmd="pigz -dc"
+        ;;
+    tlz)
+        command -v plzip >/dev/null && cmd="plzip -dc"
+        ;;
+    tzst)
+        command -v zstd >/dev/null && cmd="zstd -T0 -dc"
+        ;;
+    esac
+    [ -n "$cmd" ] || return 1
+    echo "$cmd"
+}
+
+# Print the command decompressing the tarball $1 from stdin to stdout,
+# the parallel one if available; fails if there is none.
+distfile_decompress_cmd() {
+    local cmd
+
+    if ! cmd=$(distfile_parallel_decompress_cmd "$1"); then
+        case $(distfile_suffix "$1") in
+        tar)        cmd="cat";;
+        txz)        cmd="xz -dc";;
+        tbz)        cmd="bzip2 -dc";;
+        tgz|crate)  cmd="gzip -dc";;
+        tlz)        cmd="lzip -dc";;
+        *)          return 1;;
+        esac
+        command -v ${cmd%% *} >/dev/null || return 1
+    fi
+    echo "$cmd"
+}
+
+# Print the checksum of the contents of a distfile
+distfile_contents_cksum() {
+    local curfile="$1" cursufx cksum
+
+    cursufx=$(distfile_suffix "$curfile") ||
+        msg_error "$pkgver: unknown distfile suffix for $curfile.\n"
+
+    case ${cursufx} in
+    tar|txz|tbz|tlz|tgz|tzst|crate)
+        cksum=$($XBPS_DIGEST_CMD <($TAR_CMD -x -O -f "$curfile"))
+        if [ $? -ne 0 ]; then
+            msg_error "$pkgver: extracting $curfile to pipe.\n"
+        fi
+        ;;
+    gz)
+        cksum=$($XBPS_DIGEST_CMD <(gunzip -c "$curfile"))
+        ;;
+    bz2)
+        cksum=$($XBPS_DIGEST_CMD <(bunzip2 -c "$curfile"))
+        ;;
+    zst)
+        cksum=$($XBPS_DIGEST_CMD <(zstd -dc "$curfile"))
+        ;;
+    zip)
+        if command -v unzip &>/dev/null; then
+            cksum=$($XBPS_DIGEST_CMD <(unzip -p "$curfile"))
+            if [ $? -ne 0 ]; then
+                msg_error "$pkgver: extracting $curfile to pipe.\n"
+            fi
+        else
+            msg_error "$pkgver: cannot find unzip bin for extraction.\n"
+        fi
+        ;;
+    rpm)
+        if command -v rpmextract &>/dev/null; then
+            cksum=$($XBPS_DIGEST_CMD <(rpm2cpio "$curfile" | $TAR_CMD -x -f -))
+            if [ $? -ne 0 ]; then
+                msg_error "$pkgver: extracting $curfile to pipe.\n"
+            fi
+        else
+            msg_error "$pkgver: cannot find rpmextract for extraction.\n"
+        fi
+        ;;
+    txt)
+        cksum=$($XBPS_DIGEST_CMD "$curfile")
+        ;;
+    7z)
+        if command -v 7z &>/dev/null; then
+            cksum=$($XBPS_DIGEST_CMD <(7z x -o "$curfile"))
+            if [ $? -ne 0 ]; then
+                msg_error "$pkgver: extracting $curfile to pipe.\n"
+            fi
+        else
+            msg_error "$pkgver: cannot find 7z bin for extraction.\n"
+        fi
+        ;;
+    gem)
+        cksum=$($XBPS_DIGEST_CMD <($TAR_CMD -x -O -f "$curfile" data.tar.gz | $TAR_CMD -xzO ))
+        ;;
+    *)
+        msg_error "$pkgver: cannot guess $curfile extract suffix. ($cursufx)\n"
+        ;;
+    esac
+
+    if [ -z "$cksum" ]; then
+        msg_error "$pkgver: cannot find contents checksum for $curfile.\n"
+    fi
+    echo "$cksum"
+}
+
+# Link the verified $distfile as $curfile with the sha256 $cksum into
+# by_sha256, where it is found by other templates using it.
+distfile_link_sha256() {
+    local distfile="$1" curfile="$2" cksum="$3"
+
+    if [ ! -f "$XBPS_SRCDISTDIR/by_sha256/${cksum}_${curfile}" ]; then
+        mkdir -p "$XBPS_SRCDISTDIR/by_sha256"
+        ln -f "$distfile" "$XBPS_SRCDISTDIR/by_sha256/${cksum}_${curfile}"
+    fi
+}
+
+# Remove $distfile, and all its links in XBPS_SRCDISTDIR.
+distfile_purge() {
+    local inode
+
+    inode=$(stat "$1" --printf "%i") || return 0
+    find ${XBPS_SRCDISTDIR} -inum ${inode} -delete -print
+}
+
+distfiles_unverified() {
+    echo "${XBPS_STATEDIR}/${sourcepkg}_${XBPS_CROSS_BUILD}_distfiles_unverified"
+}
+
+# Returns 0 if the distfiles are extracted by the do-extract hook, rather
+# than by a do_extract() of the template or of its build style.
+distfiles_extracted_by_hook() {
+    declare -f do_extract >/dev/null && return 1
+    [ -n "$build_style" ] || return 0
+    (
+        . $XBPS_BUILDSTYLEDIR/${build_style}.sh
+        ! declare -f do_extract
+    ) >/dev/null 2>&1
+}
+
+# Returns 0 if the checksum of $curfile is left to the do-extract hook.
+distfile_verified_by_extract() {
+    local curfile="$1" j
+
+    [ -n "$XBPS_DISTFILES_VERIFY_EXTRACT" -a "$XBPS_TARGET" != "fetch" ] || return 1
+    distfiles_extracted_by_hook || return 1
+    for j in ${skip_extraction}; do
+        [ "$curfile" = "$j" ] && return 1
+    done
+    distfile_decompress_cmd "$curfile" >/dev/null
+}
+
+# Print the unverified checksum of $curfile, if any.
+distfile_unverified_cksum() {
+    local list=$(distfiles_unverified)
+
+    [ -f "$list" ] || return 0
+    awk -v f="$1" '$2 == f { print $1; exit }' "$list"
+}
+
+# Remove $curfile from the list of unverified distfiles.
+distfile_set_verified() {
+    local list=$(distfiles_unverified)
+
+    [ -f "$list" ] || return 0
+    awk -v f="$1" '$2 != f' "$list" > "$list.new" && mv -f "$list.new" "$list"
+    [ -s "$list" ] || rm -f "$list"
+}
+
+# Verify the checksums of all distfiles still unverified.
+distfiles_verify_unverified() {
+    local list=$(distfiles_unverified) srcdir="$XBPS_SRCDISTDIR/$pkgname-$version"
+    local cksum curfile filesum TAR_CMD
+
+    [ -f "$list" ] || return 0
+    TAR_CMD="$(command -v bsdtar)"
+    [ -z "$TAR_CMD" ] && TAR_CMD="$(command -v tar)"
+    while read -r cksum curfile; do
+        msg_normal "$pkgver: verifying checksum for distfile '$curfile'... "
+        if [ "${cksum:0:1}" = "@" ]; then
+            filesum="@$(distfile_contents_cksum "$srcdir/$curfile")"
+        else
+            filesum=$(${XBPS_DIGEST_CMD} "$srcdir/$curfile")
+        fi
+        if [ "$cksum" != "$filesum" ]; then
+            echo
+            msg_red "SHA256 mismatch for '$curfile:'\n$filesum\n"
+            distfile_purge "$srcdir/$curfile"
+            msg_error "$pkgver: couldn't verify distfiles, exiting...\n"
+        fi
+        [ "${cksum:0:1}" != "@" ] && distfile_link_sha256 "$srcdir/$curfile" "$curfile" "$cksum"
+        msg_normal_append "OK.\n"
+    done < "$list"
+    rm -f "$list"
+}
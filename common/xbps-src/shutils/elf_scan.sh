@@ -0,0 +1,88 @@
+# vim: set ts=4 sw=4 et:
+#
+# elf_scan <dir> [find(1) tests]
+#
+# Prints a line for every ELF file and static archive in <dir> (matching
+# the optional find tests), with the tab separated fields
+#
+#   <path> <type> <machine> <interpreter> <soname> <needed libs>
+#
+# <type> is one of exec, static, pie, shared, object or archive, matching
+# the file(1) types application/x-executable (dynamically or statically
+# linked), x-pie-executable, x-sharedlib, x-object and x-archive.
+# <machine> is as printed by readelf(1), "None" if unset. Fields that
+# don't apply are "-". Files are read by a few readelf(1) runs instead
+# of forking file(1) and objdump(1) for every file.
+
+elf_scan() {
+    local dir="$1" list
+    shift
+
+    list=$(mktemp) || exit 1
+    find "$dir" -type f "$@" > $list 2>/dev/null
+    elf_scan_list $list
+    rm -f $list
+}
+
+# Like elf_scan(), for the files listed one per line in the given file.
+elf_scan_list() {
+    local list="$1"
+
+    # with more than one file readelf prints a "File:" line before each.
+    xargs -r -d '\n' sh -c '${READELF:-readelf} -W -h -l -d "$@" /dev/null' readelf \
+        < $list 2>/dev/null | awk -v list="$list" -v OFS='\t' '
+        function out(s) { return s == "" ? "-" : s }
+        function flush() {
+            if (file == "")
+                return
+            if (type == "DYN")
+                type = pie ? "pie" : "shared"
+            else if (type == "EXEC")
+                type = (interp != "" || dynamic) ? "exec" : "static"
+            else if (type == "REL")
+                type = "object"
+            else
+                type = ""
+            if (type != "")
+                print file, type, out(mach), out(interp), out(soname), out(needed)
+            file = ""
+        }
+        BEGIN {
+            while ((getline f < list) > 0)
+                files[f] = 1
+        }
+        /^File: / {
+            flush()
+            file = substr($0, 7)
+            type = mach = interp = soname = needed = ""
+            pie = dynamic = 0
+            if (file in files)
+                next
+            # member of a static archive: "File: <archive>(<member>)"
+            for (i = 1; i <= length(file); i++) {
+                if (substr(file, i, 1) == "(" && substr(file, 1, i - 1) in files) {
+                    if (!(substr(file, 1, i - 1) in archives)) {
+                        archives[substr(file, 1, i - 1)] = 1
+                        print substr(file, 1, i - 1), "archive", "-", "-", "-", "-"
+                    }
+                    break
+                }
+            }
+            file = ""
+            next
+        }
+        file == "" { next }
+        /^  Type:/ { type = $2 }
+        /^  Machine:/ { sub(/^  Machine:[ \t]*/, ""); mach = $0 }
+        /Requesting program interpreter: / {
+            sub(/.*interpreter: /, ""); sub(/\]$/, ""); interp = $0
+        }
+        /^Dynamic section at/ { dynamic = 1 }
+        /\(FLAGS_1\)/ && / PIE/ { pie = 1 }
+        /\(SONAME\)/ { sub(/.*\[/, ""); sub(/\].*/, ""); soname = $0 }
+        /\(NEEDED\)/ {
+            sub(/.*\[/, ""); sub(/\].*/, "")
+            needed = needed == "" ? $0 : needed " " $0
+        }
+        END { flush() }'
+}
@@ -0,0 +1,90 @@
+# vim: set ts=4 sw=4 et:
+#
+# A GNU make jobserver shared by all xbps-src instances using the same
+# hostdir, enabled by XBPS_JOBSERVER: 'yes' for a pool of nproc jobs, or
+# the number of jobs. The pool is the fifo hostdir/jobserver/fifo, kept
+# open and filled with tokens by a holder process started by the first
+# instance; instances hold a shared lock on hostdir/jobserver/users, and
+# the holder exits once no instance holds it anymore.
+#
+# The build and check phases export it to make(1), ninja(1) and cargo as
+# MAKEFLAGS="--jobserver-auth=fifo:<path>" (see common/environment/build/
+# jobserver.sh), build styles of tools without jobserver support take tokens
+# with jobserver_take().
+
+jobserver_fifo() {
+    echo "$XBPS_HOSTDIR/jobserver/fifo"
+}
+
+# Keep the fifo in $1 open with $2 tokens until no instance uses it.
+jobserver_hold() {
+    local dir="$1" tokens="$2" lfd
+
+    exec 3<>$dir/fifo || exit 1
+    [ $tokens -gt 0 ] && printf "%${tokens}s" "" | tr ' ' '+' >&3
+    while sleep 10; do
+        exec {lfd}>$dir/lock
+        flock $lfd
+        if flock -n -x $dir/users true; then
+            rm -f $dir/fifo $dir/pid
+            exit 0
+        fi
+        exec {lfd}>&-
+    done
+}
+
+# Join the jobserver, starting it if needed. The shared lock is held by the
+# fd _jobserver_fd until this process and its children exit.
+jobserver_join() {
+    local dir="$XBPS_HOSTDIR/jobserver" jobs lfd pid
+
+    [ -n "$XBPS_JOBSERVER" -a -z "$IN_CHROOT" -a -z "$_jobserver_fd" ] || return 0
+    case "$XBPS_JOBSERVER" in
+        yes) jobs=$(nproc);;
+        *[!0-9]*|0) msg_error "xbps-src: invalid XBPS_JOBSERVER value '$XBPS_JOBSERVER'.\n";;
+        *) jobs=$XBPS_JOBSERVER;;
+    esac
+
+    mkdir -p $dir || return 1
+    exec {lfd}>$dir/lock
+    flock $lfd
+    [ -f $dir/pid ] && read -r pid < $dir/pid
+    if [ -z "$pid" ] || ! kill -0 $pid 2>/dev/null || [ ! -p $dir/fifo ]; then
+        rm -f $dir/fifo
+        mkfifo -m 600 $dir/fifo || { exec {lfd}>&-; return 1; }
+        # every client has an implicit job of its own; not a child of
+        # ours, not to be waited for.
+        (
+            exec {lfd}>&-
+            trap '' HUP INT
+            jobserver_hold $dir $((jobs - 1)) &
+            echo $! > $dir/pid
+        ) </dev/null >/dev/null 2>&1
+        msg_normal "xbps-src: started jobserver with $jobs jobs.\n"
+    fi
+    exec {_jobserver_fd}>>$dir/users
+    flock -s $_jobserver_fd
+    exec {lfd}>&-
+}
+
+# Take up to $1 tokens from the jobserver without waiting for them, into
+# _jobserver_tokens; fails if there is no jobserver.
+jobserver_take() {
+    local max="$1" tok
+
+    _jobserver_tokens=
+    [ -n "$XBPS_JOBSERVER" -a -z "$disable_parallel_build" -a -p "$(jobserver_fifo)" ] || return 1
+    exec {_jobserver_tfd}<>$(jobserver_fifo) || return 1
+    while [ ${#_jobserver_tokens} -lt $max ] &&
+        read -r -N 1 -t 0.01 -u $_jobserver_tfd tok; do
+        _jobserver_tokens+="$tok"
+    done
+}
+
+# Give back the tokens taken by jobserver_take().
+jobserver_return() {
+    [ -n "$_jobserver_tfd" ] || return 0
+    [ -n "$_jobserver_tokens" ] && printf "%s" "$_jobserver_tokens" >&$_jobserver_tfd
+    exec {_jobserver_tfd}>&-
+    _jobserver_tokens= _jobserver_tfd=
+}
@@ -59,6 +59,8 @@ pkg_available() {
 remove_pkg_autodeps() {
     local rval= tmplogf= errlogf= prevs=
 
+    # the snapshot build root is dropped by chroot_handler()
+    [ -n "$XBPS_CHROOT_SNAPSHOT" ] && return 0
     cd $XBPS_MASTERDIR || return 1
     msg_normal "${pkgver:-xbps-src}: removing autodeps, please wait...\n"
     tmplogf=$(mktemp) || exit 1
@@ -1,85 +1,84 @@
 # Scan srcpkgs/*/template for hashes and distfiles to determine
 # obsolete sources/by_sha256 files and their corresponding
-# sources/<pkgname>-<version> files that can be purged
+# sources/<pkgname>-<version> files that can be purged.
+# The templates are scanned by a single grep(1), the distfiles by a single
+# find(1); obsolete files are then found by awk(1) hash lookups.
 
 
 purge_distfiles() {
-	readonly HASHLEN=64
+	local dryrun="$1" tmpdir nhashes nfiles
+	local HASHLEN=64
 	if [ -z "$XBPS_SRCDISTDIR" ]; then
 		msg_error "The variable \$XBPS_SRCDISTDIR is not set."
 		exit 1
 	fi
+	if [ -n "$dryrun" -a "$dryrun" != "dry-run" ]; then
+		msg_error "purge-distfiles: invalid argument $dryrun.\n"
+	fi
+	tmpdir=$(mktemp -d) || exit 1
+
 	#
 	# Scan all templates for their current distfiles and checksums (hashes)
 	#
-	declare -A my_hashes
-	templates=($(find srcpkgs -mindepth 1 -maxdepth 1 -type d -printf "srcpkgs/%f/template\n"))
-	max=${#templates[@]}
-	cur=0
-	if [ -z "$max" ]; then
+	find srcpkgs -mindepth 2 -maxdepth 2 -type f -name template -print0 | \
+		xargs -0 -r grep -Ehow "[0-9a-f]{$HASHLEN}" | sort -u > $tmpdir/hashes
+	nhashes=$(wc -l < $tmpdir/hashes)
+	if [ $nhashes -eq 0 ]; then
+		rm -rf $tmpdir
 		msg_error "No srcpkgs/*/template files found. Wrong working directory?"
 		exit 1
 	fi
-	percent=-1
-	for template in ${templates[@]}; do
-		pkg=${template#*/}
-		pkg=${pkg%/*}
-		if [ ! -L "srcpkgs/$pkg" ]; then
-			checksum="$(grep -Ehrow [0-9a-f]{$HASHLEN} ${template}|sort|uniq|tr '\n' ' ')"
-			read -a _my_hashes <<< ${checksum}
-			i=0
-			while [ -n "${_my_hashes[$i]}" ]; do
-				hash="${_my_hashes[$i]}"
-				[ -z "${my_hashes[$hash]}" ] && my_hashes[$hash]=$template
-				i=$((i + 1))
-			done
-		fi
-		cur=$((cur + 1))
-		pnew=$((100 * cur / max))
-		if [ $pnew -ne $percent ]; then
-			percent=$pnew
-			printf "\rScanning templates  : %3d%% (%d/%d)" $percent $cur $max
-		fi
-	done
-	echo
-	echo "Number of hashes    : ${#my_hashes[@]}"
+	echo "Number of hashes    : $nhashes"
 
 	#
 	# Collect inodes of all distfiles in $XBPS_SRCDISTDIR
 	#
-	declare -A inodes
-	distfiles=($XBPS_SRCDISTDIR/*/*)
-	max=${#distfiles[@]}
-	if [ -z "$max" ]; then
+	find "$XBPS_SRCDISTDIR" -mindepth 2 -maxdepth 2 ! -type d \
+		-printf '%i\t%s\t%p\n' > $tmpdir/distfiles
+	nfiles=$(wc -l < $tmpdir/distfiles)
+	if [ $nfiles -eq 0 ]; then
+		rm -rf $tmpdir
 		msg_error "No distfiles files found in '$XBPS_SRCDISTDIR'"
 		exit 1
 	fi
-	cur=0
-	percent=-1
-	for distfile in ${distfiles[@]}; do
-		inode=$(stat "$distfile" --printf "%i")
-		if [ -z "${inodes[$inode]}" ]; then
-			inodes[$inode]="$distfile"
+	echo "Number of distfiles : $nfiles"
+
+	#
+	# The by_sha256 files of hashes no template has anymore, and all
+	# distfiles with the same inode.
+	#
+	awk -F '\t' -v hashes=$tmpdir/hashes -v cache="$XBPS_SRCDISTDIR/by_sha256" \
+		-v hashlen=$HASHLEN -v remove=$tmpdir/remove '
+		BEGIN {
+			while ((getline h < hashes) > 0)
+				keep[h]
+		}
+		NR == FNR {
+			if (substr($3, 1, length(cache) + 1) != cache "/")
+				next
+			hash = substr($3, length(cache) + 2, hashlen)
+			if (hash in keep || $1 in obsolete)
+				next
+			obsolete[$1]
+			printf "Obsolete %s (inode: %s)\n", hash, $1
+			n++
+			bytes += $2
+			next
+		}
+		$1 in obsolete { print $3 > remove }
+		END {
+			printf "%d obsolete distfiles, %.1f MiB\n", n, bytes / 1048576
+		}' $tmpdir/distfiles $tmpdir/distfiles
+
+	if [ -s $tmpdir/remove ]; then
+		if [ -n "$dryrun" ]; then
+			sed "s/^/Would remove /" $tmpdir/remove
 		else
-			inodes[$inode]+="|$distfile"
-		fi
-		cur=$((cur + 1))
-		pnew=$((100 * cur / max))
-		if [ $pnew -ne $percent ]; then
-			percent=$pnew
-			printf "\rCollecting inodes   : %3d%% (%d/%d)" $percent $cur $max
+			xargs -r -d '\n' rm -vf < $tmpdir/remove
+			sed 's,/[^/]*$,,' $tmpdir/remove | sort -u | \
+				xargs -r -d '\n' rmdir 2>/dev/null
 		fi
-	done
-	echo
-
-	hashes=($XBPS_SRCDISTDIR/by_sha256/*)
-	for file in ${hashes[@]}; do
-		hash_distfile=${file##*/}
-		hash=${hash_distfile:0:$HASHLEN}
-		[ -n "${my_hashes[$hash]}" ] && continue
-		inode=$(stat "$file" --printf "%i")
-		echo "Obsolete $hash (inode: $inode)"
-		( IFS="|"; for f in ${inodes[$inode]}; do rm -vf "$f"; rmdir "${f%/*}" 2>/dev/null; done )
-	done
+	fi
+	rm -rf $tmpdir
 	echo "Done."
 }
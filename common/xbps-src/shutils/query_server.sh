@@ -0,0 +1,132 @@
+# vim: set ts=4 sw=4 et:
+#
+# 'xbps-src query-server' answers metadata queries of other xbps-src
+# invocations over a Unix socket, from the template index, without
+# running the initialization of xbps-src for every query. The client
+# side is query_server_forward() in xbps-src.
+#
+# A request is a line "<target> <pkgname> <xbps-src options>" followed
+# by the settings of query_server_env(); the reply is the output of the
+# target followed by a "status <rv>" line. Status 255 tells the client
+# to evaluate the query itself, which is also done for anything unusual
+# (e.g. settings that differ from the server's) so that errors are
+# reported as usual.
+
+query_server_answer() {
+    local target="$1" pkg="$2" x arr
+
+    template_index_load $pkg || return 255
+    case "$target" in
+        show-avail)
+            template_index_buildable || return 2
+            show_avail
+            ;;
+        show-build-deps)
+            template_index_deps || return 255
+            [ -z "$build_deps" ] || echo "$build_deps"
+            ;;
+        show-shlib-provides)
+            PKGDESTDIR=$XBPS_DESTDIR/$XBPS_CROSS_TRIPLET/${pkg}-${version}
+            show_pkg_shlib_provides
+            ;;
+        dbulk-dump)
+            template_index_buildable || return 255
+            ( check_pkg_arch "$XBPS_CROSS_BUILD" ) &>/dev/null || return 255
+            [ -z "$show_deps_failed" ] || return 255
+            for x in pkgname version revision; do
+                printf '%s: %s\n' "$x" "${!x}"
+            done
+            [[ $bootstrap ]] && printf '%s: %s\n' bootstrap "$bootstrap"
+            for x in hostmakedepends makedepends; do
+                arr=(${!x})
+                if [[ ${#arr} -gt 0 ]]; then
+                    printf '%s:\n' "$x"
+                    printf ' %s\n' "${arr[@]}"
+                fi
+            done
+            if [[ $dbulk_depends ]]; then
+                printf 'depends:\n'
+                printf ' %s\n' $dbulk_depends
+            fi
+            if [[ $subpackages ]]; then
+                printf 'subpackages:\n'
+                printf ' %s\n' $subpackages
+            fi
+            ;;
+        *)
+            return 255
+            ;;
+    esac
+}
+
+# Forget the template hashes if anything changed, so the next queries
+# re-check their templates, and the environment hash if common/ or etc/
+# (virtual pkgs, conf) changed.
+# Without inotifywait(1) both are recomputed on every query.
+query_server_refresh() {
+    local f
+
+    if [ -z "$changes" ]; then
+        _template_index_dir=
+        _template_index_hash=()
+        return
+    fi
+    while read -r -t 0 -u $changes && read -r -u $changes f; do
+        case "$f" in
+            $XBPS_COMMONDIR/*|$XBPS_DISTDIR/etc/*) _template_index_dir=;;
+        esac
+        _template_index_hash=()
+    done
+}
+
+query_server() {
+    local sock="$1" target pkg options env rv fd rfd wfd changes= watcher=
+
+    if ! command -v socat &>/dev/null; then
+        msg_error "xbps-src: cannot find socat(1) command!\n"
+    fi
+    if [ -n "$XBPS_CROSS_BUILD" ]; then
+        source ${XBPS_CROSSPFDIR}/${XBPS_CROSS_BUILD}.sh
+    fi
+
+    msg_normal "xbps-src: updating the template index ...\n"
+    template_index_update
+
+    if command -v inotifywait &>/dev/null; then
+        fd=$(mktemp -u) && mkfifo -m 600 $fd || exit 1
+        exec {changes}<>$fd
+        rm -f $fd
+        inotifywait -m -r -q -e close_write,create,delete,move \
+            --format '%w%f' $XBPS_SRCPKGDIR $XBPS_COMMONDIR $XBPS_DISTDIR/etc \
+            >&$changes 2>/dev/null &
+        watcher=$!
+    else
+        msg_warn "xbps-src: cannot find inotifywait(1), checking templates on every query\n"
+    fi
+    trap "${watcher:+kill $watcher;} rm -f '$sock'; exit 0" INT TERM
+
+    msg_normal "xbps-src: answering queries on $sock\n"
+    while :; do
+        # the request is followed by EOF, wait for the reply anyway.
+        coproc QUERY { socat -t 60 UNIX-LISTEN:"$sock",unlink-early,umask=077 STDIO 2>/dev/null; }
+        # coproc fds are not inherited by subshells, use copies.
+        exec {rfd}<&${QUERY[0]} {wfd}>&${QUERY[1]}
+        eval "exec ${QUERY[0]}<&- ${QUERY[1]}>&-"
+        if read -r target pkg options <&$rfd; then
+            IFS= read -r env <&$rfd || env=
+            query_server_refresh
+            if [[ $pkg =~ ^[[:alnum:]._+-]+$ ]] && [ "$options" = "$(echo $XBPS_OPTIONS)" ] &&
+                [ "$env" = "$_query_server_env" ]; then
+                # hash the template here so that it is remembered
+                [ -n "${_template_index_hash[$pkg]}" ] || template_index_update $pkg
+                ( query_server_answer "$target" "$pkg" ) 2>/dev/null >&$wfd
+                rv=$?
+            else
+                rv=255
+            fi
+            echo "status $rv" >&$wfd
+        fi
+        exec {wfd}>&- {rfd}<&-
+        wait $QUERY_PID
+    done
+}
@@ -0,0 +1,104 @@
+# vim: set ts=4 sw=4 et:
+#
+# Registration of binpkgs in the repodata of local repositories, shared by
+# concurrent builds. Rather than each build running xbps-rindex(1), which
+# rewrites the whole repodata, builds add their binpkgs to the queue
+# <repo>/.rindex-queue, as "<arch> <force> <binpkg>" lines, and wait for the
+# lock <repo>/.rindex-lock; whoever gets it registers everything queued so
+# far, a single xbps-rindex(1) run per arch. A build holding the lock finds
+# its binpkgs either registered by the previous holder or still queued.
+# Binpkgs of a failed run are marked in <repo>/.rindex-failed/, so that the
+# builds they belong to fail too.
+#
+# With XBPS_RINDEX_INTERVAL set, the repodata is not rewritten more than
+# once per that many seconds, letting more binpkgs queue up meanwhile.
+
+# Add the binpkgs $4... to the queue of $1, for arch $2 and forced if $3
+# is "-f".
+rindex_queue() {
+    local repo="$1" arch="$2" force="${3:--}" binpkg qfd
+    shift 3
+
+    exec {qfd}>>$repo/.rindex-queue || return 1
+    flock $qfd
+    for binpkg; do
+        rm -f "$repo/.rindex-failed/$binpkg"
+        printf "%s %s %s\n" "$arch" "$force" "$binpkg" >&$qfd
+    done
+    exec {qfd}>&-
+}
+
+# Register the binpkgs queued in $1; fails if any of the binpkgs $2...
+# of this build could not be registered.
+rindex_commit() {
+    local repo="$1" lfd qfd batch arch force wait binpkg rval=0
+    local -a binpkgs
+    shift
+
+    exec {lfd}>>$repo/.rindex-lock || return 1
+    if ! flock -n $lfd; then
+        msg_normal "Waiting for the repodata of $repo\n"
+        flock $lfd
+    fi
+    # take the queue
+    exec {qfd}>>$repo/.rindex-queue
+    flock $qfd
+    batch=$(sort -u $repo/.rindex-queue)
+    : > $repo/.rindex-queue
+    exec {qfd}>&-
+    if [ -z "$batch" ]; then
+        rindex_failed $repo "$@"
+        rval=$?
+        exec {lfd}>&-
+        return $rval
+    fi
+
+    if [ -n "$XBPS_RINDEX_INTERVAL" -a -f $repo/.rindex-stamp ]; then
+        wait=$(( $(stat -c %Y $repo/.rindex-stamp) + XBPS_RINDEX_INTERVAL - $(date +%s) ))
+        if [ $wait -gt 0 ]; then
+            sleep $wait
+            # more may have been queued meanwhile
+            exec {qfd}>>$repo/.rindex-queue
+            flock $qfd
+            batch=$( (echo "$batch"; cat $repo/.rindex-queue) | sort -u)
+            : > $repo/.rindex-queue
+            exec {qfd}>&-
+        fi
+    fi
+
+    while read -r arch force; do
+        binpkgs=($(awk -v a="$arch" -v f="$force" '$1 == a && $2 == f { print $3 }' <<< "$batch"))
+        [ "$force" = "-" ] && force=
+        msg_normal "Registering ${#binpkgs[@]} new packages to $repo ($arch)\n"
+        if ! XBPS_TARGET_ARCH=$arch $XBPS_RINDEX_CMD \
+            ${XBPS_REPO_COMPTYPE:+--compression $XBPS_REPO_COMPTYPE} ${force} \
+            -a "${binpkgs[@]/#/$repo/}"; then
+            msg_red "Failed to register in $repo: ${binpkgs[*]}\n"
+            mkdir -p $repo/.rindex-failed
+            for binpkg in "${binpkgs[@]}"; do
+                : > "$repo/.rindex-failed/$binpkg"
+            done
+        fi
+    done < <(awk '{ print $1, $2 }' <<< "$batch" | sort -u)
+    touch $repo/.rindex-stamp
+    rindex_failed $repo "$@"
+    rval=$?
+    exec {lfd}>&-
+    return $rval
+}
+
+# Fails if any of the binpkgs $2... is marked as failed in $1, clearing
+# their marks.
+rindex_failed() {
+    local repo="$1" binpkg rval=0
+    shift
+
+    for binpkg; do
+        if [ -e "$repo/.rindex-failed/$binpkg" ]; then
+            rm -f "$repo/.rindex-failed/$binpkg"
+            msg_red "$binpkg was not registered in $repo\n"
+            rval=1
+        fi
+    done
+    return $rval
+}
@@ -0,0 +1,34 @@
+# vim: set ts=4 sw=4 et:
+#
+# Index of common/shlibs: hostdir/shlibs-index/<hash> holds its
+# "<soname> <pkgver>" entries sorted by soname, entries of the same
+# soname kept in the order of common/shlibs. <hash> is the sha256 of
+# common/shlibs, so a changed file gets a new index.
+
+shlibs_index() {
+    local shlibs=$XBPS_COMMONDIR/shlibs hash idx tmpf f
+
+    hash=$(sha256sum < $shlibs) || return 1
+    idx=$XBPS_HOSTDIR/shlibs-index/${hash:0:16}
+    if [ ! -f $idx ]; then
+        mkdir -p ${idx%/*} || return 1
+        tmpf=$(mktemp $idx.XXXXXXXX) || return 1
+        awk '!/^#/ && NF >= 2 { print $1, $2 }' $shlibs | \
+            LC_ALL=C sort -s -k1,1 > $tmpf && mv -f $tmpf $idx || return 1
+        # drop the indexes of older versions of common/shlibs
+        for f in ${idx%/*}/*; do
+            [[ $f == $idx || ${f##*/} == *.* ]] || rm -f $f
+        done
+    fi
+    echo $idx
+}
+
+# Print the "<soname> <pkgver>" entries of all sonames passed, looked
+# up with a single join(1) over the index.
+shlibs_lookup() {
+    local idx
+
+    [ $# -gt 0 ] || return 0
+    idx=$(shlibs_index) || return 1
+    printf "%s\n" "$@" | LC_ALL=C sort -u | LC_ALL=C join -j1 - $idx
+}
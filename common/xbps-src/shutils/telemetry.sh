@@ -0,0 +1,187 @@
+# vim: set ts=4 sw=4 et:
+#
+# Build telemetry, enabled by XBPS_TELEMETRY: the phases, functions and hooks
+# of a build are recorded with their wall time, user/sys CPU time, bytes
+# read and written, peak RSS and peak number of processes. The records are
+# saved as JSON in the statedir and in hostdir/telemetry/<arch>/<sourcepkg>.json,
+# bulk builds collect the reports of the packages built into a single one.
+#
+# CPU time comes from the rusage of the shell and its reaped children (the
+# times builtin) and the I/O from its io accounting, which also includes
+# reaped children; peak RSS (summed over all processes) and number of
+# processes are sampled from /proc by a process that is not a child of the
+# build, so that it is not accounted for.
+
+telemetry_records() {
+    echo "${XBPS_STATEDIR}/${sourcepkg}_${XBPS_CROSS_BUILD}_telemetry"
+}
+
+telemetry_file() {
+    echo "$XBPS_HOSTDIR/telemetry/${XBPS_CROSS_BUILD:-$XBPS_MACHINE}/$1.json"
+}
+
+# Sample the peak RSS in KiB and number of processes of the process tree
+# of $1 into $2, until killed or $1 is gone.
+telemetry_sample() {
+    local root="$1" out="$2" page rss procs peak_rss=0 peak_procs=0
+
+    page=$(getconf PAGESIZE)
+    while :; do
+        read -r rss procs < <(cat /proc/[0-9]*/stat 2>/dev/null |
+            awk -v root=$root -v page=$page '
+            {
+                # the command name may contain spaces and parentheses
+                s = $0; sub(/.*\) /, "", s); split(s, f, " ")
+                ppid[$1] = f[2]; rss[$1] = f[22]
+            }
+            END {
+                for (p in ppid) {
+                    for (q = p; q != root && q + 0 > 1 && (q in ppid); q = ppid[q])
+                        ;
+                    if (q == root) { n++; r += rss[p] }
+                }
+                print int(r * page / 1024), n + 0
+            }')
+        [ "${rss:-0}" -gt $peak_rss ] && peak_rss=$rss
+        [ "${procs:-0}" -gt $peak_procs ] && peak_procs=$procs
+        # gone once the measure is recorded
+        [ -e $out ] || break
+        echo "$peak_rss $peak_procs" > $out.tmp && mv -f $out.tmp $out
+        sleep 0.5
+        # the build failed and exited before telemetry_end()
+        kill -0 $root 2>/dev/null || break
+    done
+}
+
+# Set _telemetry_counters to the user and sys CPU time in ms, and the bytes
+# read and written, of this shell and its reaped children.
+telemetry_counters() {
+    local tmpf="${XBPS_STATEDIR}/.telemetry.$BASHPID" line us ss uc sc m s
+    local key val rd=0 wr=0 IFS=$' \t\n'
+
+    # not in a subshell, times would report the subshell
+    times > $tmpf
+    {
+        read -r us ss
+        read -r uc sc
+    } < $tmpf
+    rm -f $tmpf
+    for m in us ss uc sc; do
+        line=${!m}
+        s=${line#*m}
+        s=${s%s}
+        printf -v $m "%d" $(( ${line%%m*} * 60000 + 10#${s%.*} * 1000 + 10#${s#*.} ))
+    done
+    if [ -r /proc/$BASHPID/io ]; then
+        while read -r key val; do
+            case "$key" in
+                read_bytes:) rd=$val;;
+                write_bytes:) wr=$val;;
+            esac
+        done < /proc/$BASHPID/io
+    fi
+    _telemetry_counters="$((us + uc)) $((ss + sc)) $rd $wr"
+}
+
+# Start measuring; telemetry_end() records the measure.
+telemetry_begin() {
+    local root=$BASHPID
+
+    [ -n "$XBPS_TELEMETRY" -a -d "$XBPS_STATEDIR" ] || return 0
+
+    _telemetry_start=$EPOCHREALTIME
+    telemetry_counters
+    _telemetry_begin=$_telemetry_counters
+    _telemetry_sample=$(mktemp -p ${XBPS_STATEDIR} .telemetry.XXXXXXXX) || return 0
+    # not our child: neither waited for nor accounted
+    (
+        telemetry_sample $root $_telemetry_sample </dev/null >/dev/null 2>&1 &
+        echo $! > $_telemetry_sample.pid
+    )
+    [[ $(trap -p EXIT) == *telemetry_stop* ]] || exit_trap_add telemetry_stop
+}
+
+# Stop the sampling started by telemetry_begin(), also run on exit; keeps
+# $? for the rest of the EXIT trap.
+telemetry_stop() {
+    local rv=$? pid
+
+    if [ -n "$_telemetry_sample" -a -f "$_telemetry_sample.pid" ]; then
+        read -r pid < $_telemetry_sample.pid
+        kill $pid 2>/dev/null
+    fi
+    return $rv
+}
+
+# Record the measure started by telemetry_begin() as $2 of type $1 (phase,
+# func or hook).
+telemetry_end() {
+    local type="$1" name="$2" end=$EPOCHREALTIME rss=null procs=null
+    local u0 s0 r0 w0 u1 s1 r1 w1 IFS=$' \t\n'
+
+    [ -n "$_telemetry_start" ] || return 0
+    telemetry_counters
+    read -r u1 s1 r1 w1 <<< "$_telemetry_counters"
+    read -r u0 s0 r0 w0 <<< "$_telemetry_begin"
+    telemetry_stop
+    if [ -n "$_telemetry_sample" ]; then
+        [ -s $_telemetry_sample ] && read -r rss procs < $_telemetry_sample
+        rm -f $_telemetry_sample $_telemetry_sample.pid $_telemetry_sample.tmp
+    fi
+    printf '{"type":"%s","name":"%s","pkg":"%s","wall_ms":%d,"user_ms":%d,"sys_ms":%d,"read_bytes":%d,"write_bytes":%d,"max_rss_kb":%s,"max_procs":%s}\n' \
+        "$type" "$name" "$pkgname" \
+        $(( (${end/[.,]/} - ${_telemetry_start/[.,]/}) / 1000 )) \
+        $((u1 - u0)) $((s1 - s0)) $((r1 - r0)) $((w1 - w0)) \
+        ${rss:-null} ${procs:-null} >> $(telemetry_records)
+    _telemetry_start=
+}
+
+# Save the records of $sourcepkg as its report, in the statedir and in
+# hostdir/telemetry.
+telemetry_save() {
+    local records=$(telemetry_records) f=$(telemetry_file $sourcepkg) tmpf
+
+    [ -n "$XBPS_TELEMETRY" -a -s "$records" ] || return 0
+    {
+        printf '{"pkgver":"%s","arch":"%s","date":%d,"records":[\n' \
+            "$pkgver" "${XBPS_CROSS_BUILD:-$XBPS_MACHINE}" "$(date +%s)"
+        sed '$!s/$/,/' $records
+        printf ']}\n'
+    } > ${records}.json
+    rm -f $records
+    mkdir -p ${f%/*} && tmpf=$(mktemp $f.XXXXXXXX) || return 0
+    cp ${records}.json $tmpf && mv -f $tmpf $f
+}
+
+# Collect the reports of the pkgs $@ into hostdir/telemetry/<arch>/bulk-<date>.json,
+# and show the slowest and most memory hungry steps.
+telemetry_report() {
+    local dir="$XBPS_HOSTDIR/telemetry/${XBPS_CROSS_BUILD:-$XBPS_MACHINE}"
+    local report="$dir/bulk-$(date +%Y%m%d-%H%M%S).json" pkg f sep=
+
+    [ -n "$XBPS_TELEMETRY" -a $# -gt 0 ] || return 0
+    mkdir -p $dir || return 0
+    {
+        printf '{"date":%d,"packages":{\n' "$(date +%s)"
+        for pkg; do
+            f=$(telemetry_file $pkg)
+            [ -f $f ] || continue
+            printf '%s"%s":' "$sep" "$pkg"
+            cat $f
+            sep=,
+        done
+        printf '}}\n'
+    } > $report || return 0
+    msg_normal "xbps-src: telemetry report in $report\n"
+    # a record per line: pkg, type, name, wall, max_rss
+    sed -n 's/^{"type":"\([^"]*\)","name":"\([^"]*\)","pkg":"\([^"]*\)","wall_ms":\([0-9]*\),.*"max_rss_kb":\([0-9a-z]*\).*/\3 \1 \2 \4 \5/p' $report |
+        awk '$2 == "phase" { next }
+            $4 + 0 > wall { wall = $4 + 0; wstep = $1 " " $3 }
+            $5 != "null" && $5 + 0 > rss { rss = $5 + 0; rstep = $1 " " $3 }
+            END {
+                if (wstep != "")
+                    printf " slowest step: %s (%.1fs)\n", wstep, wall / 1000
+                if (rstep != "")
+                    printf " largest RSS:  %s (%d MiB)\n", rstep, rss / 1024
+            }'
+}
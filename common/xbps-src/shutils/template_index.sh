@@ -0,0 +1,143 @@
+# vim: set ts=4 sw=4 et:
+#
+# Index of evaluated templates, so that targets working on many packages
+# don't have to source every template again. Entries are stored in
+#
+#   hostdir/template-index/<arch>/<env>/<pkgname>@<hash>
+#
+# where <env> is a hash of everything besides the template that changes
+# what setup_pkg() evaluates and <hash> is the sha256 of the template.
+# An entry holds the variables in TEMPLATE_INDEX_VARS as shell assignments;
+# entries whose template failed to evaluate only set template_index_failed.
+#
+# Only what comes from the template itself is stored: the build dependencies
+# are resolved to source pkgs by template_index_deps() when needed, as that
+# depends on other templates and on the subpackage symlinks.
+
+TEMPLATE_INDEX_VARS="pkgname version revision sourcepkg subpackages
+    depends makedepends hostmakedepends checkdepends conflicts provides
+    replaces shlib_provides shlib_requires archs broken restricted nocross
+    bootstrap build_style build_options
+    run_deps show_deps_failed dbulk_depends"
+
+declare -A _template_index_hash
+
+template_index_init() {
+    local f envhash
+
+    [ -n "$_template_index_dir" ] && return 0
+
+    envhash=$( {
+        # everything setup_pkg() sources besides the template
+        find $XBPS_COMMONDIR/environment $XBPS_BUILDHELPERDIR \
+            $XBPS_COMMONDIR/build-profiles $XBPS_COMMONDIR/cross-profiles \
+            -type f -name '*.sh' | sort | xargs cat
+        cat $XBPS_SHUTILSDIR/common.sh $XBPS_SHUTILSDIR/show.sh \
+            $XBPS_SHUTILSDIR/build_dependencies.sh \
+            $XBPS_SHUTILSDIR/template_index.sh $XBPS_CONFIG_FILE \
+            $XBPS_DISTDIR/etc/virtual $XBPS_DISTDIR/etc/defaults.virtual
+        for f in ${!XBPS_PKG_OPTIONS*}; do
+            echo "$f=${!f}"
+        done
+        echo "$CHROOT_READY:$XBPS_ALLOW_RESTRICTED:$XBPS_CHECK_PKGS:$XBPS_DEBUG_PKGS"
+    } 2>/dev/null | sha256sum)
+    _template_index_dir=$XBPS_HOSTDIR/template-index/${XBPS_CROSS_BUILD:-${XBPS_ARCH:-$XBPS_MACHINE}}/${envhash:0:16}
+    mkdir -p $_template_index_dir
+}
+
+template_index_eval() {
+    local pkg="$1" hash="$2" entry tmpf f
+
+    entry=$_template_index_dir/$pkg@$hash
+    tmpf=$(mktemp $entry.XXXXXXXX) || return 1
+    (
+        unset XBPS_BINPKG_EXISTS
+        XBPS_TARGET_PKG=$pkg
+        setup_pkg $pkg "$XBPS_CROSS_BUILD" ignore-problems &>/dev/null
+        run_deps=$(setup_pkg_depends "" 1 1 2>/dev/null) || show_deps_failed=1
+        dbulk_depends=$(printf "%s\n" $run_deps | \
+            { grep -vF "$(printf "%s\n" $pkgname $subpackages)" || :; } | sort -u)
+        for f in $TEMPLATE_INDEX_VARS; do
+            printf '%s=%q\n' $f "${!f}"
+        done
+    ) > $tmpf || echo "template_index_failed=1" > $tmpf
+    # drop the entries of older revisions of the template
+    for f in $_template_index_dir/$pkg@*; do
+        [[ ${f##*@} == *.* ]] || rm -f $f
+    done
+    mv -f $tmpf $entry
+}
+
+# Bring the entries of the given pkgs (all pkgs if none) up to date,
+# evaluating changed templates in parallel.
+template_index_update() {
+    local pkg hash f i=0
+    local -a pkgs paths stale
+
+    template_index_init
+    [ $# -gt 0 ] || set -- $(cd $XBPS_SRCPKGDIR && echo */)
+    for pkg; do
+        pkg=${pkg%/}
+        f=${pkg%-32bit}/template
+        [ -f $XBPS_SRCPKGDIR/$f ] || continue
+        pkgs+=($pkg)
+        paths+=($f)
+    done
+    [ ${#pkgs[@]} -gt 0 ] || return 0
+
+    while read -r hash f; do
+        pkg=${pkgs[$i]}
+        i=$((i+1))
+        _template_index_hash[$pkg]=$hash
+        [ -f $_template_index_dir/$pkg@$hash ] || stale+=("$pkg $hash")
+    done < <(cd $XBPS_SRCPKGDIR && sha256sum "${paths[@]}")
+    [ ${#stale[@]} -eq 0 ] || run_jobs $(nproc) template_index_eval "${stale[@]}"
+}
+
+# Load the entry of a pkg into the current shell, usually a subshell.
+# Returns 1 if the template could not be evaluated.
+template_index_load() {
+    local _pkg="$1" _entry
+
+    [ -n "${_template_index_hash[$_pkg]}" ] || template_index_update $_pkg
+    _entry=$_template_index_dir/$_pkg@${_template_index_hash[$_pkg]}
+    [ -r "$_entry" ] || return 1
+    unset -v $TEMPLATE_INDEX_VARS template_index_failed \
+        build_deps hostmakedepends_deps makedepends_deps
+    . $_entry
+    [ -z "$template_index_failed" ]
+}
+
+# Set build_deps, hostmakedepends_deps and makedepends_deps of the loaded
+# pkg, as show-build-deps, show-hostmakedepends and show-makedepends print
+# them. Returns 1 and sets show_deps_failed if they cannot be resolved.
+template_index_deps() {
+    local CROSS_BUILD="$XBPS_CROSS_BUILD" pkgver="${pkgname}-${version}_${revision}"
+
+    [ -z "$show_deps_failed" ] || return 1
+    build_deps=$(show_pkg_build_depends "${makedepends} ${run_deps}" \
+        "${hostmakedepends}" 2>/dev/null) &&
+    hostmakedepends_deps=$(show_pkg_build_depends "" "${hostmakedepends}" 2>/dev/null) &&
+    makedepends_deps=$(show_pkg_build_depends "${makedepends}" "" 2>/dev/null) ||
+        { show_deps_failed=1; return 1; }
+}
+
+# Returns 1 if the loaded pkg cannot be built in this configuration.
+template_index_buildable() {
+    [ -n "$broken" ] && return 1
+    [ -n "$restricted" -a -z "$XBPS_ALLOW_RESTRICTED" ] && return 1
+    [ -n "$XBPS_CROSS_BUILD" -a -n "$nocross" ] && return 1
+    return 0
+}
+
+# Print a variable of the target pkg from the index. Returns 1 if the
+# caller has to evaluate the template itself, e.g. to report an error.
+show_indexed() {
+    [ -n "$XBPS_TARGET_PKG" ] || return 1
+    (
+        template_index_load $XBPS_TARGET_PKG && template_index_deps || exit 1
+        if [ -n "${!1}" ]; then
+            echo "${!1}"
+        fi
+    )
+}
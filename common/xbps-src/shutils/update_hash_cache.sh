@@ -1,12 +1,115 @@
 # vim: set ts=4 sw=4 et:
+#
+# The sha256 of the distfiles in XBPS_SRCDISTDIR is kept in the index
+# XBPS_SRCDISTDIR/.sha256-index, with a line per file of the tab separated
+#
+#   <device> <inode> <size> <mtime> <sha256> <path>
+#
+# Files whose device, inode, size and mtime are in the index are not
+# hashed again, the others are hashed in parallel.
+
+# Print the sha256 of the file with the given index in the list collected
+# by update_hash_cache(), run by run_jobs().
+hash_distfile() {
+    local sum
+
+    sum=$($XBPS_DIGEST_CMD "${_hash_paths[$1]}") || return 1
+    printf "%s\t%s\n" "${_hash_keys[$1]}" "$sum"
+}
 
 update_hash_cache() {
-    local cache="$XBPS_SRCDISTDIR/by_sha256"
-    local distfile curfile
+    local cache="$XBPS_SRCDISTDIR/by_sha256" index="$XBPS_SRCDISTDIR/.sha256-index"
+    local tmpdir tmpf dev ino size mtime sum path name max cur=0 bytes=0 percent=-1 pnew
+    local -a _hash_keys _hash_paths
+
     mkdir -p "$cache"
-    find "$XBPS_SRCDISTDIR" -type f | grep -v by_sha256 | while read -r distfile; do
-        cksum=$($XBPS_DIGEST_CMD "$distfile")
-        curfile="${distfile##*/}"
-        ln -vf "$distfile" "${cache}/${cksum}_${curfile}"
-    done
+    tmpdir=$(mktemp -d) || exit 1
+    touch "$index"
+
+    find "$XBPS_SRCDISTDIR" -path "$cache" -prune -o -type f \
+        ! -path "$index" ! -path "$index.*" \
+        -printf '%D\t%i\t%s\t%T@\t%p\n' > $tmpdir/files
+    # the files not in the index, hard links hashed once
+    awk -F '\t' -v index_="$index" '
+        BEGIN {
+            while ((getline l < index_) > 0) {
+                split(l, f, "\t")
+                known[f[1] FS f[2] FS f[3] FS f[4]]
+            }
+        }
+        !(($1 FS $2 FS $3 FS $4) in known) && !seen[$1 FS $2]++' \
+        $tmpdir/files > $tmpdir/todo
+    while IFS=$'\t' read -r dev ino size mtime path; do
+        _hash_keys+=("$dev"$'\t'"$ino"$'\t'"$size"$'\t'"$mtime")
+        _hash_paths+=("$path")
+    done < $tmpdir/todo
+
+    max=${#_hash_paths[@]}
+    if [ $max -gt 0 ]; then
+        run_jobs $(nproc) hash_distfile ${!_hash_paths[@]} | \
+            while IFS=$'\t' read -r dev ino size mtime sum; do
+                printf "%s\t%s\t%s\t%s\t%s\n" $dev $ino $size $mtime $sum
+                cur=$((cur + 1))
+                bytes=$((bytes + size))
+                pnew=$((100 * cur / max))
+                if [ $pnew -ne $percent ]; then
+                    percent=$pnew
+                    printf "\rHashing distfiles   : %3d%% (%d/%d, %d MiB)" \
+                        $percent $cur $max $((bytes / 1048576)) >&2
+                fi
+            done > $tmpdir/hashed
+        echo >&2
+    else
+        : > $tmpdir/hashed
+    fi
+
+    # The new index: the files still there, with their hash from the old
+    # index or hashed now.
+    tmpf=$(mktemp "$index.XXXXXXXX") || exit 1
+    awk -F '\t' -v OFS='\t' -v index_="$index" -v hashed=$tmpdir/hashed '
+        function load(file,    l, f) {
+            while ((getline l < file) > 0) {
+                split(l, f, "\t")
+                sum[f[1] FS f[2] FS f[3] FS f[4]] = f[5]
+            }
+        }
+        BEGIN { load(index_); load(hashed) }
+        (($1 FS $2 FS $3 FS $4) in sum) { print $1, $2, $3, $4, sum[$1 FS $2 FS $3 FS $4], $5 }' \
+        $tmpdir/files > $tmpf && mv -f $tmpf "$index"
+
+    # Link the files missing in by_sha256, or linked to another inode.
+    find "$cache" -maxdepth 1 -type f -printf '%i\t%f\n' > $tmpdir/links
+    awk -F '\t' -v links=$tmpdir/links '
+        BEGIN {
+            while ((getline l < links) > 0) {
+                split(l, f, "\t")
+                have[f[2]] = f[1]
+            }
+        }
+        { n = split($6, p, "/"); name = $5 "_" p[n]
+          if ((name in have) && have[name] == $2) ok[name] = 1
+          else if (!(name in want)) want[name] = $6 }
+        END { for (name in want) if (!(name in ok)) print want[name] "\t" name }' \
+        "$index" | while IFS=$'\t' read -r path name; do
+            ln -vf "$path" "${cache}/${name}"
+        done
+
+    awk -F '\t' -v hashed=$tmpdir/hashed '
+        BEGIN {
+            while ((getline l < hashed) > 0) {
+                split(l, f, "\t")
+                h[f[1] FS f[2]]
+            }
+        }
+        !seen[$1 FS $2]++ {
+            if (($1 FS $2) in h) { hn++; hb += $3 } else { sn++; sb += $3 }
+        }
+        END {
+            printf "Hashed %d files (%d MiB), skipped %d unchanged files (%d MiB).\n",
+                hn, hb / 1048576, sn, sb / 1048576
+        }' "$index"
+    if [ $(wc -l < $tmpdir/hashed) -ne $max ]; then
+        msg_warn "failed to hash $((max - $(wc -l < $tmpdir/hashed))) distfiles.\n"
+    fi
+    rm -rf $tmpdir
 }
@@ -0,0 +1,194 @@
+/*
+ * Stress test of the atomic queues of <sys/queue.h>, printing their
+ * throughput.
+ *
+ *   STAILQ_*_ATOMIC  producers append, a consumer takes whole queues
+ *   MPSCQ            producers insert, a consumer removes one at a time
+ *   SLIST_ATOMIC     all threads pop and push back a shared set of
+ *                    elements, which exercises the ABA protection
+ *
+ * Every element must be seen exactly once, and in insertion order for
+ * each producer of the queues.
+ */
+#include <pthread.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <sys/queue.h>
+
+#define	NTHREADS	4
+#define	NELEMS		200000
+#define	NROUNDS		200000
+
+struct elem {
+	STAILQ_ENTRY(elem) sq_link;
+	MPSCQ_ENTRY(elem) mq_link;
+	SLIST_ATOMIC_ENTRY(elem) sl_link;
+	int producer;
+	int seq;
+};
+
+static STAILQ_HEAD(, elem) sq = STAILQ_HEAD_INITIALIZER(sq);
+static MPSCQ_HEAD(, elem) mq = MPSCQ_HEAD_INITIALIZER(mq);
+static SLIST_ATOMIC_HEAD(, elem) sl = SLIST_ATOMIC_HEAD_INITIALIZER(sl);
+
+static struct elem elems[NTHREADS][NELEMS];
+
+static void
+fail(const char *msg)
+{
+	fprintf(stderr, "queue-atomic-test: %s\n", msg);
+	exit(1);
+}
+
+static double
+now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void
+report(const char *name, long ops, double start)
+{
+	printf("%-14s %10.0f ops/s\n", name, ops / (now() - start));
+}
+
+static void
+check(int *next, struct elem *e)
+{
+	if (e->seq != next[e->producer])
+		fail("element out of order or seen twice");
+	next[e->producer]++;
+}
+
+static void *
+stailq_producer(void *arg)
+{
+	struct elem *e = arg;
+	int i;
+
+	for (i = 0; i < NELEMS; i++)
+		STAILQ_INSERT_TAIL_ATOMIC(&sq, &e[i], sq_link);
+	return NULL;
+}
+
+static void *
+mpscq_producer(void *arg)
+{
+	struct elem *e = arg;
+	int i;
+
+	for (i = 0; i < NELEMS; i++)
+		MPSCQ_INSERT_TAIL(&mq, &e[i], mq_link);
+	return NULL;
+}
+
+static void *
+slist_worker(void *arg)
+{
+	struct elem *e;
+	int i;
+
+	(void)arg;
+	for (i = 0; i < NROUNDS; i++) {
+		if ((e = SLIST_ATOMIC_REMOVE_HEAD(&sl, elem, sl_link)) == NULL)
+			continue;
+		e->seq++;
+		SLIST_ATOMIC_INSERT_HEAD(&sl, e, sl_link);
+	}
+	return NULL;
+}
+
+static void
+start(pthread_t *tids, void *(*fn)(void *))
+{
+	int t;
+
+	for (t = 0; t < NTHREADS; t++) {
+		if (pthread_create(&tids[t], NULL, fn, elems[t]) != 0)
+			fail("pthread_create failed");
+	}
+}
+
+static void
+join(pthread_t *tids)
+{
+	int t;
+
+	for (t = 0; t < NTHREADS; t++)
+		pthread_join(tids[t], NULL);
+}
+
+int
+main(void)
+{
+	STAILQ_HEAD(, elem) batch;
+	pthread_t tids[NTHREADS];
+	struct elem *e;
+	int next[NTHREADS] = { 0 };
+	long n = 0;
+	double t0;
+	int t, i;
+
+	for (t = 0; t < NTHREADS; t++) {
+		for (i = 0; i < NELEMS; i++) {
+			elems[t][i].producer = t;
+			elems[t][i].seq = i;
+		}
+	}
+
+	t0 = now();
+	start(tids, stailq_producer);
+	while (n < (long)NTHREADS * NELEMS) {
+		STAILQ_INIT(&batch);
+		STAILQ_TAKE_ATOMIC(&sq, &batch, sq_link);
+		STAILQ_FOREACH(e, &batch, sq_link) {
+			check(next, e);
+			n++;
+		}
+	}
+	join(tids);
+	if (!STAILQ_EMPTY(&sq))
+		fail("STAILQ not empty");
+	report("STAILQ_ATOMIC", n, t0);
+
+	for (t = 0; t < NTHREADS; t++)
+		next[t] = 0;
+	n = 0;
+	t0 = now();
+	start(tids, mpscq_producer);
+	while (n < (long)NTHREADS * NELEMS) {
+		if ((e = MPSCQ_REMOVE_HEAD(&mq, elem, mq_link)) == NULL)
+			continue;
+		check(next, e);
+		n++;
+	}
+	join(tids);
+	if (MPSCQ_REMOVE_HEAD(&mq, elem, mq_link) != NULL || !MPSCQ_EMPTY(&mq))
+		fail("MPSCQ not empty");
+	report("MPSCQ", n, t0);
+
+	/* A few elements, so that the same ones are reused all the time */
+	for (i = 0; i < 2 * NTHREADS; i++) {
+		elems[0][i].seq = 0;
+		SLIST_ATOMIC_INSERT_HEAD(&sl, &elems[0][i], sl_link);
+	}
+	t0 = now();
+	start(tids, slist_worker);
+	join(tids);
+	report("SLIST_ATOMIC", 2L * NTHREADS * NROUNDS, t0);
+	n = 0;
+	for (i = 0; (e = SLIST_ATOMIC_REMOVE_HEAD(&sl, elem, sl_link)) != NULL;
+	    i++)
+		n += e->seq;
+	if (i != 2 * NTHREADS || !SLIST_ATOMIC_EMPTY(&sl))
+		fail("SLIST_ATOMIC lost or duplicated elements");
+	if (n > (long)NTHREADS * NROUNDS)
+		fail("SLIST_ATOMIC element updated more than once per round");
+
+	return 0;
+}
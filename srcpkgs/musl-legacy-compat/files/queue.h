@@ -77,6 +77,21 @@
  * A circle queue may be traversed in either direction, but has a more
  * complex end of list detection.
  *
+ * A multi-producer single-consumer queue is an intrusive FIFO that any
+ * number of threads may insert into without a lock, while one thread at
+ * a time removes elements from the head.  Insertion is wait-free, a
+ * removal may fail spuriously while an insertion is in progress.
+ *
+ * An atomic singly-linked list is a lock-free LIFO (Treiber stack).
+ * The head pairs the first element with a generation count that is
+ * updated together with it, which guards removals against ABA.  Elements
+ * must stay mapped as long as other threads may be removing elements.
+ *
+ * The atomic variants of the singly-linked tail queue functions let any
+ * number of threads append elements or whole queues to a shared queue
+ * while one thread at a time takes all queued elements over into a
+ * private queue, which suits batch handoff between threads.
+ *
  * For details on the use of these macros, see the queue(3) manual page.
  */
 
@@ -656,6 +671,212 @@ struct {								\
 		((char *)((head)->stqh_last) - offsetof(struct type, field))))
 
 
+#if defined(__ATOMIC_ACQUIRE)
+/*
+ * Singly-linked Tail queue atomic functions.  The 16 byte atomics
+ * used by the atomic singly-linked list may need -latomic.
+ */
+#define	STAILQ_INSERT_TAIL_ATOMIC(head, elm, field) do {		\
+	__typeof__(elm) *__prev;					\
+	__atomic_store_n(&(elm)->field.stqe_next, NULL, __ATOMIC_RELAXED);\
+	__prev = __atomic_exchange_n(&(head)->stqh_last,		\
+	    &(elm)->field.stqe_next, __ATOMIC_ACQ_REL);			\
+	__atomic_store_n(__prev, (elm), __ATOMIC_RELEASE);		\
+} while (/*CONSTCOND*/0)
+
+#define	STAILQ_CONCAT_ATOMIC(head1, head2) do {				\
+	if (!STAILQ_EMPTY((head2))) {					\
+		__typeof__((head2)->stqh_last) __prev;			\
+		__prev = __atomic_exchange_n(&(head1)->stqh_last,	\
+		    (head2)->stqh_last, __ATOMIC_ACQ_REL);		\
+		__atomic_store_n(__prev, (head2)->stqh_first,		\
+		    __ATOMIC_RELEASE);					\
+		STAILQ_INIT((head2));					\
+	}								\
+} while (/*CONSTCOND*/0)
+
+/*
+ * Moves all elements of head to the empty queue dst.  Appends that are
+ * still linking their elements are waited for.
+ */
+#define	STAILQ_TAKE_ATOMIC(head, dst, field) do {			\
+	__typeof__((head)->stqh_first) __elm, __next;			\
+	__typeof__((head)->stqh_last) __last;				\
+	if (__atomic_load_n(&(head)->stqh_last, __ATOMIC_ACQUIRE) !=	\
+	    &(head)->stqh_first) {					\
+		while ((__elm = __atomic_load_n(&(head)->stqh_first,	\
+		    __ATOMIC_ACQUIRE)) == NULL)				\
+			continue;					\
+		__atomic_store_n(&(head)->stqh_first, NULL, __ATOMIC_RELAXED);\
+		__last = __atomic_exchange_n(&(head)->stqh_last,	\
+		    &(head)->stqh_first, __ATOMIC_ACQ_REL);		\
+		(dst)->stqh_first = __elm;				\
+		(dst)->stqh_last = __last;				\
+		while (&__elm->field.stqe_next != __last) {		\
+			while ((__next = __atomic_load_n(		\
+			    &__elm->field.stqe_next, __ATOMIC_ACQUIRE)) == NULL)\
+				continue;				\
+			__elm = __next;					\
+		}							\
+	}								\
+} while (/*CONSTCOND*/0)
+
+/*
+ * Multi-producer single-consumer queue definitions.
+ */
+struct __mpscq_entry {
+	struct __mpscq_entry *mqe_next;	/* next element */
+};
+
+#define	MPSCQ_HEAD(name, type)						\
+struct name {								\
+	struct __mpscq_entry *mqh_head;	/* last inserted element */	\
+	struct __mpscq_entry *mqh_tail;	/* next element to remove */	\
+	struct __mpscq_entry mqh_stub;	/* placeholder element */	\
+}
+
+#define	MPSCQ_HEAD_INITIALIZER(head)					\
+	{ &(head).mqh_stub, &(head).mqh_stub, { NULL } }
+
+#define	MPSCQ_ENTRY(type)						\
+	struct __mpscq_entry
+
+static __inline void
+__mpscq_insert(struct __mpscq_entry **__headp, struct __mpscq_entry *__e)
+{
+	struct __mpscq_entry *__prev;
+
+	__atomic_store_n(&__e->mqe_next, NULL, __ATOMIC_RELAXED);
+	__prev = __atomic_exchange_n(__headp, __e, __ATOMIC_ACQ_REL);
+	__atomic_store_n(&__prev->mqe_next, __e, __ATOMIC_RELEASE);
+}
+
+static __inline void *
+__mpscq_remove(struct __mpscq_entry **__headp, struct __mpscq_entry **__tailp,
+    struct __mpscq_entry *__stub, unsigned long __off)
+{
+	struct __mpscq_entry *__tail = *__tailp, *__next;
+
+	__next = __atomic_load_n(&__tail->mqe_next, __ATOMIC_ACQUIRE);
+	if (__tail == __stub) {
+		if (__next == NULL)
+			return NULL;
+		*__tailp = __tail = __next;
+		__next = __atomic_load_n(&__tail->mqe_next, __ATOMIC_ACQUIRE);
+	}
+	if (__next == NULL) {
+		/* An insertion is in progress or tail is the last element */
+		if (__tail != __atomic_load_n(__headp, __ATOMIC_ACQUIRE))
+			return NULL;
+		__mpscq_insert(__headp, __stub);
+		__next = __atomic_load_n(&__tail->mqe_next, __ATOMIC_ACQUIRE);
+		if (__next == NULL)
+			return NULL;
+	}
+	*__tailp = __next;
+	return (char *)__tail - __off;
+}
+
+/*
+ * Multi-producer single-consumer queue functions.
+ */
+#define	MPSCQ_INIT(head) do {						\
+	(head)->mqh_stub.mqe_next = NULL;				\
+	(head)->mqh_head = (head)->mqh_tail = &(head)->mqh_stub;	\
+} while (/*CONSTCOND*/0)
+
+#define	MPSCQ_INSERT_TAIL(head, elm, field)				\
+	__mpscq_insert(&(head)->mqh_head, &(elm)->field)
+
+/* Only one thread at a time may remove elements */
+#define	MPSCQ_REMOVE_HEAD(head, type, field)				\
+	((struct type *)__mpscq_remove(&(head)->mqh_head, &(head)->mqh_tail,\
+	    &(head)->mqh_stub, offsetof(struct type, field)))
+
+#define	MPSCQ_EMPTY(head)						\
+	((head)->mqh_tail == &(head)->mqh_stub &&			\
+	    __atomic_load_n(&(head)->mqh_stub.mqe_next, __ATOMIC_ACQUIRE) == NULL)
+
+/*
+ * Atomic singly-linked List definitions.
+ */
+struct __slist_atomic_top {
+	void *sat_first;		/* first element */
+	unsigned long sat_gen;		/* generation of sat_first */
+} __attribute__((__aligned__(2 * sizeof(void *))));
+
+#define	SLIST_ATOMIC_HEAD(name, type)					\
+struct name {								\
+	struct __slist_atomic_top slah_top;	/* first element */	\
+}
+
+#define	SLIST_ATOMIC_HEAD_INITIALIZER(head)				\
+	{ { NULL, 0 } }
+
+#define	SLIST_ATOMIC_ENTRY(type)					\
+	SLIST_ENTRY(type)
+
+static __inline void
+__slist_atomic_insert(struct __slist_atomic_top *__top, void *__elm,
+    void **__nextp)
+{
+	struct __slist_atomic_top __old, __new;
+
+	__atomic_load(__top, &__old, __ATOMIC_RELAXED);
+	do {
+		__atomic_store_n(__nextp, __old.sat_first, __ATOMIC_RELAXED);
+		__new.sat_first = __elm;
+		__new.sat_gen = __old.sat_gen + 1;
+	} while (!__atomic_compare_exchange(__top, &__old, &__new, 1,
+	    __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+}
+
+static __inline void *
+__slist_atomic_remove(struct __slist_atomic_top *__top, unsigned long __off)
+{
+	struct __slist_atomic_top __old, __new;
+
+	__atomic_load(__top, &__old, __ATOMIC_ACQUIRE);
+	do {
+		if (__old.sat_first == NULL)
+			return NULL;
+		__new.sat_first = __atomic_load_n(
+		    (void **)((char *)__old.sat_first + __off), __ATOMIC_RELAXED);
+		__new.sat_gen = __old.sat_gen + 1;
+	} while (!__atomic_compare_exchange(__top, &__old, &__new, 1,
+	    __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE));
+	return __old.sat_first;
+}
+
+static __inline int
+__slist_atomic_empty(struct __slist_atomic_top *__top)
+{
+	struct __slist_atomic_top __cur;
+
+	__atomic_load(__top, &__cur, __ATOMIC_RELAXED);
+	return __cur.sat_first == NULL;
+}
+
+/*
+ * Atomic singly-linked List functions.
+ */
+#define	SLIST_ATOMIC_INIT(head) do {					\
+	(head)->slah_top.sat_first = NULL;				\
+	(head)->slah_top.sat_gen = 0;					\
+} while (/*CONSTCOND*/0)
+
+#define	SLIST_ATOMIC_EMPTY(head)					\
+	__slist_atomic_empty(&(head)->slah_top)
+
+#define	SLIST_ATOMIC_INSERT_HEAD(head, elm, field)			\
+	__slist_atomic_insert(&(head)->slah_top, (elm),			\
+	    (void **)&(elm)->field.sle_next)
+
+#define	SLIST_ATOMIC_REMOVE_HEAD(head, type, field)			\
+	((struct type *)__slist_atomic_remove(&(head)->slah_top,	\
+	    offsetof(struct type, field.sle_next)))
+#endif /* __ATOMIC_ACQUIRE */
+
 #ifndef _KERNEL
 /*
  * Circular queue definitions. Do not use. We still keep the macros
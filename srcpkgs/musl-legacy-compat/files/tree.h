@@ -53,6 +53,35 @@
  *
  * Every operation on a red-black tree is bounded as O(lg n).
  * The maximum height of a red-black tree is 2lg (n+1).
+ *
+ * A weak AVL (WAVL) tree is a rank-balanced binary search tree.  Every
+ * node carries an integer rank, a missing child has rank -1.  It
+ * fulfills a set of conditions:
+ *	- the rank difference between a node and each of its children
+ *	  is either 1 or 2,
+ *	- each leaf node has rank 0.
+ *
+ * Lookups never modify a WAVL tree, an insertion performs at most two
+ * rotations and so does a removal.  A WAVL tree built by insertions
+ * only is an AVL tree with a height of at most 1.44lg n; the height
+ * never exceeds 2lg n.
+ *
+ * An intrusive hash table is an open-addressed array of pointers to
+ * the elements.  Collisions are resolved by linear probing and removal
+ * shifts the rest of the probe run back, so the table never contains
+ * tombstones.  Every element caches its hash value and its slot.
+ * Lookups, insertions and removals are expected O(1).
+ *
+ * A B-tree is a B+tree of elements stored by value.  Leaf nodes hold
+ * the elements, inner nodes hold copies of separating keys, and every
+ * node is a single allocation aligned to a cache line that holds up to
+ * `order' entries.  It fulfills a set of conditions:
+ *	- every node but the root holds at least order / 2 entries,
+ *	- all leaves are at the same depth and are linked in order.
+ *
+ * Traversal walks the element arrays of the linked leaves, which keeps
+ * it dense and prefetchable.  Every operation is bounded as
+ * O(log n / log order) node visits.
  */
 
 #define SPLAY_HEAD(name, type)						\
@@ -758,4 +787,1199 @@ name##_RB_MINMAX(struct name *head, int val)				\
 	    ((x) != NULL) && ((y) = name##_RB_PREV(x), (x) != NULL);	\
 	     (x) = (y))
 
+/* Macros that define a weak AVL tree */
+#define WAVL_HEAD(name, type)						\
+struct name {								\
+	struct type *wvh_root; /* root of the tree */			\
+}
+
+#define WAVL_INITIALIZER(root)						\
+	{ NULL }
+
+#define WAVL_INIT(root) do {						\
+	(root)->wvh_root = NULL;					\
+} while (/*CONSTCOND*/ 0)
+
+#define WAVL_ENTRY(type)						\
+struct {								\
+	struct type *wve_left;		/* left element */		\
+	struct type *wve_right;		/* right element */		\
+	struct type *wve_parent;	/* parent element */		\
+	int wve_rank;			/* node rank */			\
+}
+
+#define WAVL_LEFT(elm, field)		(elm)->field.wve_left
+#define WAVL_RIGHT(elm, field)		(elm)->field.wve_right
+#define WAVL_PARENT(elm, field)		(elm)->field.wve_parent
+#define WAVL_RANK(elm, field)		(elm)->field.wve_rank
+#define WAVL_ROOT(head)			(head)->wvh_root
+#define WAVL_EMPTY(head)		(WAVL_ROOT(head) == NULL)
+
+/* Rank of a possibly missing element */
+#define WAVL_RANKOF(elm, field)						\
+	((elm) == NULL ? -1 : WAVL_RANK(elm, field))
+
+#define WAVL_SET(elm, parent, field) do {				\
+	WAVL_PARENT(elm, field) = parent;				\
+	WAVL_LEFT(elm, field) = WAVL_RIGHT(elm, field) = NULL;		\
+	WAVL_RANK(elm, field) = 0;					\
+} while (/*CONSTCOND*/ 0)
+
+#define WAVL_ISLEAF(elm, field)						\
+	(WAVL_LEFT(elm, field) == NULL && WAVL_RIGHT(elm, field) == NULL)
+
+#define WAVL_ROTATE_LEFT(head, elm, tmp, field) do {			\
+	(tmp) = WAVL_RIGHT(elm, field);					\
+	if ((WAVL_RIGHT(elm, field) = WAVL_LEFT(tmp, field)) != NULL) {	\
+		WAVL_PARENT(WAVL_LEFT(tmp, field), field) = (elm);	\
+	}								\
+	if ((WAVL_PARENT(tmp, field) = WAVL_PARENT(elm, field)) != NULL) {\
+		if ((elm) == WAVL_LEFT(WAVL_PARENT(elm, field), field))	\
+			WAVL_LEFT(WAVL_PARENT(elm, field), field) = (tmp);\
+		else							\
+			WAVL_RIGHT(WAVL_PARENT(elm, field), field) = (tmp);\
+	} else								\
+		(head)->wvh_root = (tmp);				\
+	WAVL_LEFT(tmp, field) = (elm);					\
+	WAVL_PARENT(elm, field) = (tmp);				\
+} while (/*CONSTCOND*/ 0)
+
+#define WAVL_ROTATE_RIGHT(head, elm, tmp, field) do {			\
+	(tmp) = WAVL_LEFT(elm, field);					\
+	if ((WAVL_LEFT(elm, field) = WAVL_RIGHT(tmp, field)) != NULL) {	\
+		WAVL_PARENT(WAVL_RIGHT(tmp, field), field) = (elm);	\
+	}								\
+	if ((WAVL_PARENT(tmp, field) = WAVL_PARENT(elm, field)) != NULL) {\
+		if ((elm) == WAVL_LEFT(WAVL_PARENT(elm, field), field))	\
+			WAVL_LEFT(WAVL_PARENT(elm, field), field) = (tmp);\
+		else							\
+			WAVL_RIGHT(WAVL_PARENT(elm, field), field) = (tmp);\
+	} else								\
+		(head)->wvh_root = (tmp);				\
+	WAVL_RIGHT(tmp, field) = (elm);					\
+	WAVL_PARENT(elm, field) = (tmp);				\
+} while (/*CONSTCOND*/ 0)
+
+/* Generates prototypes and inline functions */
+#define WAVL_PROTOTYPE(name, type, field, cmp)				\
+	WAVL_PROTOTYPE_INTERNAL(name, type, field, cmp,)
+#define	WAVL_PROTOTYPE_STATIC(name, type, field, cmp)			\
+	WAVL_PROTOTYPE_INTERNAL(name, type, field, cmp, __unused static)
+#define WAVL_PROTOTYPE_INTERNAL(name, type, field, cmp, attr)		\
+attr void name##_WAVL_INSERT_BALANCE(struct name *, struct type *);	\
+attr void name##_WAVL_REMOVE_BALANCE(struct name *, struct type *, struct type *);\
+attr struct type *name##_WAVL_REMOVE(struct name *, struct type *);	\
+attr struct type *name##_WAVL_INSERT(struct name *, struct type *);	\
+attr struct type *name##_WAVL_FIND(struct name *, struct type *);	\
+attr struct type *name##_WAVL_NFIND(struct name *, struct type *);	\
+attr struct type *name##_WAVL_NEXT(struct type *);			\
+attr struct type *name##_WAVL_PREV(struct type *);			\
+attr struct type *name##_WAVL_MINMAX(struct name *, int);		\
+									\
+
+/* Main wavl operation.
+ * Restores the rank rule after an insertion or a removal
+ */
+#define	WAVL_GENERATE(name, type, field, cmp)				\
+	WAVL_GENERATE_INTERNAL(name, type, field, cmp,)
+#define	WAVL_GENERATE_STATIC(name, type, field, cmp)			\
+	WAVL_GENERATE_INTERNAL(name, type, field, cmp, __unused static)
+#define WAVL_GENERATE_INTERNAL(name, type, field, cmp, attr)		\
+/* elm has just been inserted as a leaf of rank 0 */			\
+attr void								\
+name##_WAVL_INSERT_BALANCE(struct name *head, struct type *elm)		\
+{									\
+	struct type *parent, *sib, *inner, *tmp;			\
+	while ((parent = WAVL_PARENT(elm, field)) != NULL &&		\
+	    WAVL_RANK(parent, field) == WAVL_RANK(elm, field)) {	\
+		if (elm == WAVL_LEFT(parent, field)) {			\
+			sib = WAVL_RIGHT(parent, field);		\
+			if (WAVL_RANK(parent, field) -			\
+			    WAVL_RANKOF(sib, field) == 1) {		\
+				WAVL_RANK(parent, field)++;		\
+				elm = parent;				\
+				continue;				\
+			}						\
+			inner = WAVL_RIGHT(elm, field);			\
+			if (WAVL_RANK(elm, field) -			\
+			    WAVL_RANKOF(inner, field) == 1) {		\
+				WAVL_ROTATE_LEFT(head, elm, tmp, field);\
+				WAVL_RANK(inner, field)++;		\
+				WAVL_RANK(elm, field)--;		\
+			}						\
+			WAVL_ROTATE_RIGHT(head, parent, tmp, field);	\
+			WAVL_RANK(parent, field)--;			\
+		} else {						\
+			sib = WAVL_LEFT(parent, field);			\
+			if (WAVL_RANK(parent, field) -			\
+			    WAVL_RANKOF(sib, field) == 1) {		\
+				WAVL_RANK(parent, field)++;		\
+				elm = parent;				\
+				continue;				\
+			}						\
+			inner = WAVL_LEFT(elm, field);			\
+			if (WAVL_RANK(elm, field) -			\
+			    WAVL_RANKOF(inner, field) == 1) {		\
+				WAVL_ROTATE_RIGHT(head, elm, tmp, field);\
+				WAVL_RANK(inner, field)++;		\
+				WAVL_RANK(elm, field)--;		\
+			}						\
+			WAVL_ROTATE_LEFT(head, parent, tmp, field);	\
+			WAVL_RANK(parent, field)--;			\
+		}							\
+		break;							\
+	}								\
+}									\
+									\
+/* elm (possibly NULL) took the place of a removed child of parent */	\
+attr void								\
+name##_WAVL_REMOVE_BALANCE(struct name *head, struct type *parent, struct type *elm) \
+{									\
+	struct type *sib, *inner, *outer, *tmp;				\
+	if (WAVL_ISLEAF(parent, field) && WAVL_RANK(parent, field) == 1) {\
+		WAVL_RANK(parent, field) = 0;				\
+		elm = parent;						\
+		parent = WAVL_PARENT(elm, field);			\
+	}								\
+	while (parent != NULL &&					\
+	    WAVL_RANK(parent, field) - WAVL_RANKOF(elm, field) == 3) {	\
+		if (WAVL_LEFT(parent, field) == elm) {			\
+			sib = WAVL_RIGHT(parent, field);		\
+			if (WAVL_RANK(parent, field) -			\
+			    WAVL_RANK(sib, field) == 2) {		\
+				WAVL_RANK(parent, field)--;		\
+				elm = parent;				\
+				parent = WAVL_PARENT(elm, field);	\
+				continue;				\
+			}						\
+			inner = WAVL_LEFT(sib, field);			\
+			outer = WAVL_RIGHT(sib, field);			\
+			if (WAVL_RANK(sib, field) -			\
+			    WAVL_RANKOF(inner, field) == 2 &&		\
+			    WAVL_RANK(sib, field) -			\
+			    WAVL_RANKOF(outer, field) == 2) {		\
+				WAVL_RANK(parent, field)--;		\
+				WAVL_RANK(sib, field)--;		\
+				elm = parent;				\
+				parent = WAVL_PARENT(elm, field);	\
+				continue;				\
+			}						\
+			if (WAVL_RANK(sib, field) -			\
+			    WAVL_RANKOF(outer, field) == 1) {		\
+				WAVL_ROTATE_LEFT(head, parent, tmp, field);\
+				WAVL_RANK(sib, field)++;		\
+				WAVL_RANK(parent, field)--;		\
+				if (WAVL_ISLEAF(parent, field))		\
+					WAVL_RANK(parent, field)--;	\
+			} else {					\
+				WAVL_ROTATE_RIGHT(head, sib, tmp, field);\
+				WAVL_ROTATE_LEFT(head, parent, tmp, field);\
+				WAVL_RANK(inner, field) += 2;		\
+				WAVL_RANK(sib, field)--;		\
+				WAVL_RANK(parent, field) -= 2;		\
+			}						\
+		} else {						\
+			sib = WAVL_LEFT(parent, field);			\
+			if (WAVL_RANK(parent, field) -			\
+			    WAVL_RANK(sib, field) == 2) {		\
+				WAVL_RANK(parent, field)--;		\
+				elm = parent;				\
+				parent = WAVL_PARENT(elm, field);	\
+				continue;				\
+			}						\
+			inner = WAVL_RIGHT(sib, field);			\
+			outer = WAVL_LEFT(sib, field);			\
+			if (WAVL_RANK(sib, field) -			\
+			    WAVL_RANKOF(inner, field) == 2 &&		\
+			    WAVL_RANK(sib, field) -			\
+			    WAVL_RANKOF(outer, field) == 2) {		\
+				WAVL_RANK(parent, field)--;		\
+				WAVL_RANK(sib, field)--;		\
+				elm = parent;				\
+				parent = WAVL_PARENT(elm, field);	\
+				continue;				\
+			}						\
+			if (WAVL_RANK(sib, field) -			\
+			    WAVL_RANKOF(outer, field) == 1) {		\
+				WAVL_ROTATE_RIGHT(head, parent, tmp, field);\
+				WAVL_RANK(sib, field)++;		\
+				WAVL_RANK(parent, field)--;		\
+				if (WAVL_ISLEAF(parent, field))		\
+					WAVL_RANK(parent, field)--;	\
+			} else {					\
+				WAVL_ROTATE_LEFT(head, sib, tmp, field);\
+				WAVL_ROTATE_RIGHT(head, parent, tmp, field);\
+				WAVL_RANK(inner, field) += 2;		\
+				WAVL_RANK(sib, field)--;		\
+				WAVL_RANK(parent, field) -= 2;		\
+			}						\
+		}							\
+		break;							\
+	}								\
+}									\
+									\
+attr struct type *							\
+name##_WAVL_REMOVE(struct name *head, struct type *elm)			\
+{									\
+	struct type *child, *parent, *old = elm;			\
+	if (WAVL_LEFT(elm, field) == NULL)				\
+		child = WAVL_RIGHT(elm, field);				\
+	else if (WAVL_RIGHT(elm, field) == NULL)			\
+		child = WAVL_LEFT(elm, field);				\
+	else {								\
+		struct type *left;					\
+		elm = WAVL_RIGHT(elm, field);				\
+		while ((left = WAVL_LEFT(elm, field)) != NULL)		\
+			elm = left;					\
+		child = WAVL_RIGHT(elm, field);				\
+		parent = WAVL_PARENT(elm, field);			\
+		if (child)						\
+			WAVL_PARENT(child, field) = parent;		\
+		if (WAVL_LEFT(parent, field) == elm)			\
+			WAVL_LEFT(parent, field) = child;		\
+		else							\
+			WAVL_RIGHT(parent, field) = child;		\
+		if (WAVL_PARENT(elm, field) == old)			\
+			parent = elm;					\
+		(elm)->field = (old)->field;				\
+		if (WAVL_PARENT(old, field)) {				\
+			if (WAVL_LEFT(WAVL_PARENT(old, field), field) == old)\
+				WAVL_LEFT(WAVL_PARENT(old, field), field) = elm;\
+			else						\
+				WAVL_RIGHT(WAVL_PARENT(old, field), field) = elm;\
+		} else							\
+			WAVL_ROOT(head) = elm;				\
+		WAVL_PARENT(WAVL_LEFT(old, field), field) = elm;	\
+		if (WAVL_RIGHT(old, field))				\
+			WAVL_PARENT(WAVL_RIGHT(old, field), field) = elm;\
+		goto balance;						\
+	}								\
+	parent = WAVL_PARENT(elm, field);				\
+	if (child)							\
+		WAVL_PARENT(child, field) = parent;			\
+	if (parent) {							\
+		if (WAVL_LEFT(parent, field) == elm)			\
+			WAVL_LEFT(parent, field) = child;		\
+		else							\
+			WAVL_RIGHT(parent, field) = child;		\
+	} else								\
+		WAVL_ROOT(head) = child;				\
+balance:								\
+	if (parent)							\
+		name##_WAVL_REMOVE_BALANCE(head, parent, child);	\
+	return (old);							\
+}									\
+									\
+/* Inserts a node into the WAVL tree */					\
+attr struct type *							\
+name##_WAVL_INSERT(struct name *head, struct type *elm)			\
+{									\
+	struct type *tmp;						\
+	struct type *parent = NULL;					\
+	int comp = 0;							\
+	tmp = WAVL_ROOT(head);						\
+	while (tmp) {							\
+		parent = tmp;						\
+		comp = (cmp)(elm, parent);				\
+		if (comp < 0)						\
+			tmp = WAVL_LEFT(tmp, field);			\
+		else if (comp > 0)					\
+			tmp = WAVL_RIGHT(tmp, field);			\
+		else							\
+			return (tmp);					\
+	}								\
+	WAVL_SET(elm, parent, field);					\
+	if (parent != NULL) {						\
+		if (comp < 0)						\
+			WAVL_LEFT(parent, field) = elm;			\
+		else							\
+			WAVL_RIGHT(parent, field) = elm;		\
+	} else								\
+		WAVL_ROOT(head) = elm;					\
+	name##_WAVL_INSERT_BALANCE(head, elm);				\
+	return (NULL);							\
+}									\
+									\
+/* Finds the node with the same key as elm */				\
+attr struct type *							\
+name##_WAVL_FIND(struct name *head, struct type *elm)			\
+{									\
+	struct type *tmp = WAVL_ROOT(head);				\
+	int comp;							\
+	while (tmp) {							\
+		comp = cmp(elm, tmp);					\
+		if (comp < 0)						\
+			tmp = WAVL_LEFT(tmp, field);			\
+		else if (comp > 0)					\
+			tmp = WAVL_RIGHT(tmp, field);			\
+		else							\
+			return (tmp);					\
+	}								\
+	return (NULL);							\
+}									\
+									\
+/* Finds the first node greater than or equal to the search key */	\
+attr struct type *							\
+name##_WAVL_NFIND(struct name *head, struct type *elm)			\
+{									\
+	struct type *tmp = WAVL_ROOT(head);				\
+	struct type *res = NULL;					\
+	int comp;							\
+	while (tmp) {							\
+		comp = cmp(elm, tmp);					\
+		if (comp < 0) {						\
+			res = tmp;					\
+			tmp = WAVL_LEFT(tmp, field);			\
+		}							\
+		else if (comp > 0)					\
+			tmp = WAVL_RIGHT(tmp, field);			\
+		else							\
+			return (tmp);					\
+	}								\
+	return (res);							\
+}									\
+									\
+/* ARGSUSED */								\
+attr struct type *							\
+name##_WAVL_NEXT(struct type *elm)					\
+{									\
+	if (WAVL_RIGHT(elm, field)) {					\
+		elm = WAVL_RIGHT(elm, field);				\
+		while (WAVL_LEFT(elm, field))				\
+			elm = WAVL_LEFT(elm, field);			\
+	} else {							\
+		if (WAVL_PARENT(elm, field) &&				\
+		    (elm == WAVL_LEFT(WAVL_PARENT(elm, field), field)))	\
+			elm = WAVL_PARENT(elm, field);			\
+		else {							\
+			while (WAVL_PARENT(elm, field) &&		\
+			    (elm == WAVL_RIGHT(WAVL_PARENT(elm, field), field)))\
+				elm = WAVL_PARENT(elm, field);		\
+			elm = WAVL_PARENT(elm, field);			\
+		}							\
+	}								\
+	return (elm);							\
+}									\
+									\
+/* ARGSUSED */								\
+attr struct type *							\
+name##_WAVL_PREV(struct type *elm)					\
+{									\
+	if (WAVL_LEFT(elm, field)) {					\
+		elm = WAVL_LEFT(elm, field);				\
+		while (WAVL_RIGHT(elm, field))				\
+			elm = WAVL_RIGHT(elm, field);			\
+	} else {							\
+		if (WAVL_PARENT(elm, field) &&				\
+		    (elm == WAVL_RIGHT(WAVL_PARENT(elm, field), field)))\
+			elm = WAVL_PARENT(elm, field);			\
+		else {							\
+			while (WAVL_PARENT(elm, field) &&		\
+			    (elm == WAVL_LEFT(WAVL_PARENT(elm, field), field)))\
+				elm = WAVL_PARENT(elm, field);		\
+			elm = WAVL_PARENT(elm, field);			\
+		}							\
+	}								\
+	return (elm);							\
+}									\
+									\
+attr struct type *							\
+name##_WAVL_MINMAX(struct name *head, int val)				\
+{									\
+	struct type *tmp = WAVL_ROOT(head);				\
+	struct type *parent = NULL;					\
+	while (tmp) {							\
+		parent = tmp;						\
+		if (val < 0)						\
+			tmp = WAVL_LEFT(tmp, field);			\
+		else							\
+			tmp = WAVL_RIGHT(tmp, field);			\
+	}								\
+	return (parent);						\
+}
+
+#define WAVL_NEGINF	-1
+#define WAVL_INF	1
+
+#define WAVL_INSERT(name, x, y)	name##_WAVL_INSERT(x, y)
+#define WAVL_REMOVE(name, x, y)	name##_WAVL_REMOVE(x, y)
+#define WAVL_FIND(name, x, y)	name##_WAVL_FIND(x, y)
+#define WAVL_NFIND(name, x, y)	name##_WAVL_NFIND(x, y)
+#define WAVL_NEXT(name, x, y)	name##_WAVL_NEXT(y)
+#define WAVL_PREV(name, x, y)	name##_WAVL_PREV(y)
+#define WAVL_MIN(name, x)	name##_WAVL_MINMAX(x, WAVL_NEGINF)
+#define WAVL_MAX(name, x)	name##_WAVL_MINMAX(x, WAVL_INF)
+
+#define WAVL_FOREACH(x, name, head)					\
+	for ((x) = WAVL_MIN(name, head);				\
+	     (x) != NULL;						\
+	     (x) = name##_WAVL_NEXT(x))
+
+#define WAVL_FOREACH_FROM(x, name, y)					\
+	for ((x) = (y);							\
+	    ((x) != NULL) && ((y) = name##_WAVL_NEXT(x), (x) != NULL);	\
+	     (x) = (y))
+
+#define WAVL_FOREACH_SAFE(x, name, head, y)				\
+	for ((x) = WAVL_MIN(name, head);				\
+	    ((x) != NULL) && ((y) = name##_WAVL_NEXT(x), (x) != NULL);	\
+	     (x) = (y))
+
+#define WAVL_FOREACH_REVERSE(x, name, head)				\
+	for ((x) = WAVL_MAX(name, head);				\
+	     (x) != NULL;						\
+	     (x) = name##_WAVL_PREV(x))
+
+#define WAVL_FOREACH_REVERSE_FROM(x, name, y)				\
+	for ((x) = (y);							\
+	    ((x) != NULL) && ((y) = name##_WAVL_PREV(x), (x) != NULL);	\
+	     (x) = (y))
+
+#define WAVL_FOREACH_REVERSE_SAFE(x, name, head, y)			\
+	for ((x) = WAVL_MAX(name, head);				\
+	    ((x) != NULL) && ((y) = name##_WAVL_PREV(x), (x) != NULL);	\
+	     (x) = (y))
+
+/*
+ * Macros that define an intrusive hash table.  The slot array is
+ * allocated with calloc(3) and released with free(3), so <stdlib.h>
+ * must be included before HT_GENERATE is used.  The hash function
+ * takes an element and returns a size_t, the compare function returns
+ * 0 for elements with equal keys.
+ */
+#define HT_HEAD(name, type)						\
+struct name {								\
+	struct type **hth_table;	/* slot array */		\
+	size_t hth_size;		/* number of slots */		\
+	size_t hth_count;		/* number of elements */	\
+}
+
+#define HT_INITIALIZER(head)						\
+	{ NULL, 0, 0 }
+
+#define HT_INIT(head) do {						\
+	(head)->hth_table = NULL;					\
+	(head)->hth_size = 0;						\
+	(head)->hth_count = 0;						\
+} while (/*CONSTCOND*/ 0)
+
+#define HT_ENTRY(type)							\
+struct {								\
+	size_t hte_hash;		/* cached hash value */		\
+	size_t hte_slot;		/* slot in the table */		\
+}
+
+#define HT_HASH(elm, field)		(elm)->field.hte_hash
+#define HT_SLOT(elm, field)		(elm)->field.hte_slot
+#define HT_SIZE(head)			(head)->hth_size
+#define HT_COUNT(head)			(head)->hth_count
+#define HT_EMPTY(head)			(HT_COUNT(head) == 0)
+
+/* Smallest number of slots, must be a power of two */
+#ifndef HT_MINSIZE
+#define HT_MINSIZE	16
+#endif
+
+/* Generates prototypes and inline functions */
+#define HT_PROTOTYPE(name, type, field, hash, cmp)			\
+	HT_PROTOTYPE_INTERNAL(name, type, field, hash, cmp,)
+#define	HT_PROTOTYPE_STATIC(name, type, field, hash, cmp)		\
+	HT_PROTOTYPE_INTERNAL(name, type, field, hash, cmp, __unused static)
+#define HT_PROTOTYPE_INTERNAL(name, type, field, hash, cmp, attr)	\
+attr int name##_HT_GROW(struct name *, size_t);				\
+attr struct type *name##_HT_INSERT(struct name *, struct type *);	\
+attr struct type *name##_HT_FIND(struct name *, struct type *);		\
+attr struct type *name##_HT_REMOVE(struct name *, struct type *);	\
+attr struct type *name##_HT_NEXT(struct name *, struct type *);		\
+attr void name##_HT_DESTROY(struct name *);				\
+									\
+
+#define	HT_GENERATE(name, type, field, hash, cmp)			\
+	HT_GENERATE_INTERNAL(name, type, field, hash, cmp,)
+#define	HT_GENERATE_STATIC(name, type, field, hash, cmp)		\
+	HT_GENERATE_INTERNAL(name, type, field, hash, cmp, __unused static)
+#define HT_GENERATE_INTERNAL(name, type, field, hash, cmp, attr)	\
+/* Grows the table to at least size slots, returns -1 on ENOMEM */	\
+attr int								\
+name##_HT_GROW(struct name *head, size_t size)				\
+{									\
+	struct type **table, *tmp;					\
+	size_t i, j, n = HT_MINSIZE;					\
+	while (n < size)						\
+		n <<= 1;						\
+	if (n <= (head)->hth_size)					\
+		return (0);						\
+	if ((table = (struct type **)calloc(n,				\
+	    sizeof(*table))) == NULL)					\
+		return (-1);						\
+	for (i = 0; i < (head)->hth_size; i++) {			\
+		if ((tmp = (head)->hth_table[i]) == NULL)		\
+			continue;					\
+		for (j = HT_HASH(tmp, field) & (n - 1); table[j] != NULL;\
+		    j = (j + 1) & (n - 1))				\
+			;						\
+		table[j] = tmp;						\
+		HT_SLOT(tmp, field) = j;				\
+	}								\
+	free((head)->hth_table);					\
+	(head)->hth_table = table;					\
+	(head)->hth_size = n;						\
+	return (0);							\
+}									\
+									\
+/* Inserts elm, returns the element with the same key if there is one,	\
+ * elm itself if the table is full and cannot grow, NULL otherwise.	\
+ */									\
+attr struct type *							\
+name##_HT_INSERT(struct name *head, struct type *elm)			\
+{									\
+	struct type *tmp;						\
+	size_t h, i, mask;						\
+	if (((head)->hth_count + 1) * 4 > (head)->hth_size * 3 &&	\
+	    name##_HT_GROW(head, (head)->hth_size * 2) != 0 &&		\
+	    (head)->hth_count + 1 >= (head)->hth_size)			\
+		return (elm);						\
+	h = (hash)(elm);						\
+	mask = (head)->hth_size - 1;					\
+	for (i = h & mask; (tmp = (head)->hth_table[i]) != NULL;	\
+	    i = (i + 1) & mask) {					\
+		if (HT_HASH(tmp, field) == h && (cmp)(elm, tmp) == 0)	\
+			return (tmp);					\
+	}								\
+	HT_HASH(elm, field) = h;					\
+	HT_SLOT(elm, field) = i;					\
+	(head)->hth_table[i] = elm;					\
+	(head)->hth_count++;						\
+	return (NULL);							\
+}									\
+									\
+/* Finds the element with the same key as elm */			\
+attr struct type *							\
+name##_HT_FIND(struct name *head, struct type *elm)			\
+{									\
+	struct type *tmp;						\
+	size_t h, i, mask;						\
+	if (HT_EMPTY(head))						\
+		return (NULL);						\
+	h = (hash)(elm);						\
+	mask = (head)->hth_size - 1;					\
+	for (i = h & mask; (tmp = (head)->hth_table[i]) != NULL;	\
+	    i = (i + 1) & mask) {					\
+		if (HT_HASH(tmp, field) == h && (cmp)(elm, tmp) == 0)	\
+			return (tmp);					\
+	}								\
+	return (NULL);							\
+}									\
+									\
+/* Removes elm, which must be in the table, and closes the gap */	\
+attr struct type *							\
+name##_HT_REMOVE(struct name *head, struct type *elm)			\
+{									\
+	struct type *tmp;						\
+	size_t i, j, home, mask = (head)->hth_size - 1;			\
+	i = j = HT_SLOT(elm, field);					\
+	(head)->hth_table[i] = NULL;					\
+	for (;;) {							\
+		j = (j + 1) & mask;					\
+		if ((tmp = (head)->hth_table[j]) == NULL)		\
+			break;						\
+		home = HT_HASH(tmp, field) & mask;			\
+		/* tmp stays if its home lies cyclically in (i, j] */	\
+		if (i <= j ? (i < home && home <= j) :			\
+		    (i < home || home <= j))				\
+			continue;					\
+		(head)->hth_table[i] = tmp;				\
+		HT_SLOT(tmp, field) = i;				\
+		(head)->hth_table[j] = NULL;				\
+		i = j;							\
+	}								\
+	(head)->hth_count--;						\
+	return (elm);							\
+}									\
+									\
+/* Returns the element after elm in slot order, the first one if elm	\
+ * is NULL.								\
+ */									\
+attr struct type *							\
+name##_HT_NEXT(struct name *head, struct type *elm)			\
+{									\
+	size_t i = elm == NULL ? 0 : HT_SLOT(elm, field) + 1;		\
+	for (; i < (head)->hth_size; i++) {				\
+		if ((head)->hth_table[i] != NULL)			\
+			return ((head)->hth_table[i]);			\
+	}								\
+	return (NULL);							\
+}									\
+									\
+/* Releases the slot array, the elements are left untouched */		\
+attr void								\
+name##_HT_DESTROY(struct name *head)					\
+{									\
+	free((head)->hth_table);					\
+	HT_INIT(head);							\
+}
+
+#define HT_INSERT(name, x, y)	name##_HT_INSERT(x, y)
+#define HT_REMOVE(name, x, y)	name##_HT_REMOVE(x, y)
+#define HT_FIND(name, x, y)	name##_HT_FIND(x, y)
+#define HT_NEXT(name, x, y)	name##_HT_NEXT(x, y)
+#define HT_FIRST(name, x)	name##_HT_NEXT(x, NULL)
+#define HT_RESERVE(name, x, n)	name##_HT_GROW(x, ((n) * 4 + 2) / 3)
+#define HT_DESTROY(name, x)	name##_HT_DESTROY(x)
+
+/*
+ * The table must not be modified while it is being traversed; the
+ * order of the traversal is unspecified.
+ */
+#define HT_FOREACH(x, name, head)					\
+	for ((x) = HT_FIRST(name, head);				\
+	     (x) != NULL;						\
+	     (x) = name##_HT_NEXT(head, x))
+
+/*
+ * Macros that define a B-tree.  Nodes are allocated with
+ * posix_memalign(3) and released with free(3), so <stdlib.h> and
+ * <string.h> must be included before BTREE_GENERATE is used, and
+ * BTREE_PROTOTYPE must precede it.  The order should be at least 4.
+ * Iterators are invalidated by any insertion or removal.
+ */
+#ifndef BTREE_CACHELINE
+#define BTREE_CACHELINE	64
+#endif
+
+#if defined(__GNUC__)
+#define __BTREE_ALIGNED	__attribute__((__aligned__(BTREE_CACHELINE)))
+#else
+#define __BTREE_ALIGNED
+#endif
+
+#define BTREE_HEAD(name, type)						\
+struct name {								\
+	struct name##_BTREE_NODE *bth_root; /* root of the tree */	\
+	size_t bth_count;		/* number of elements */	\
+}
+
+#define BTREE_INITIALIZER(root)						\
+	{ NULL, 0 }
+
+#define BTREE_INIT(root) do {						\
+	(root)->bth_root = NULL;					\
+	(root)->bth_count = 0;						\
+} while (/*CONSTCOND*/ 0)
+
+#define BTREE_ITER(name)	struct name##_BTREE_ITER
+
+#define BTREE_ROOT(head)		(head)->bth_root
+#define BTREE_COUNT(head)		(head)->bth_count
+#define BTREE_EMPTY(head)		(BTREE_ROOT(head) == NULL)
+
+/* Generates the node type, prototypes and inline functions */
+#define BTREE_PROTOTYPE(name, type, order, cmp)				\
+	BTREE_PROTOTYPE_INTERNAL(name, type, order, cmp,)
+#define	BTREE_PROTOTYPE_STATIC(name, type, order, cmp)			\
+	BTREE_PROTOTYPE_INTERNAL(name, type, order, cmp, __unused static)
+#define BTREE_PROTOTYPE_INTERNAL(name, type, order, cmp, attr)		\
+enum { name##_BTREE_ORDER = (order) };					\
+struct name##_BTREE_NODE {						\
+	struct name##_BTREE_NODE *btn_parent;	/* parent node */	\
+	struct name##_BTREE_NODE *btn_next;	/* next leaf */		\
+	struct name##_BTREE_NODE *btn_prev;	/* previous leaf */	\
+	unsigned int btn_count;			/* number of entries */	\
+	int btn_leaf;				/* node is a leaf */	\
+	struct type btn_elms[(order)];		/* elements or keys */	\
+	struct name##_BTREE_NODE *btn_child[(order) + 1];		\
+} __BTREE_ALIGNED;							\
+struct name##_BTREE_ITER {						\
+	struct name##_BTREE_NODE *bti_node;	/* current leaf */	\
+	unsigned int bti_idx;			/* index in the leaf */	\
+};									\
+attr struct name##_BTREE_NODE *name##_BTREE_ALLOC(int);			\
+attr void name##_BTREE_FREE(struct name##_BTREE_NODE *);		\
+attr unsigned int name##_BTREE_BOUND(struct name##_BTREE_NODE *,	\
+    struct type *, int);						\
+attr struct name##_BTREE_NODE *name##_BTREE_DESCEND(struct name *,	\
+    struct type *);							\
+attr void name##_BTREE_REBALANCE(struct name *,				\
+    struct name##_BTREE_NODE *);					\
+attr struct type *name##_BTREE_INSERT(struct name *, struct type *);	\
+attr struct type *name##_BTREE_REMOVE(struct name *, struct type *);	\
+attr size_t name##_BTREE_REMOVE_RANGE(struct name *, struct type *,	\
+    struct type *);							\
+attr struct type *name##_BTREE_FIND(struct name *, struct type *);	\
+attr struct type *name##_BTREE_LOWER_BOUND(struct name *, struct type *,\
+    struct name##_BTREE_ITER *);					\
+attr struct type *name##_BTREE_FIRST(struct name *,			\
+    struct name##_BTREE_ITER *);					\
+attr struct type *name##_BTREE_LAST(struct name *,			\
+    struct name##_BTREE_ITER *);					\
+attr struct type *name##_BTREE_NEXT(struct name##_BTREE_ITER *);	\
+attr struct type *name##_BTREE_PREV(struct name##_BTREE_ITER *);	\
+attr void name##_BTREE_DESTROY(struct name *);				\
+									\
+
+#define BTREE_MINFILL(name)	(name##_BTREE_ORDER / 2)
+
+/* Main btree operation.
+ * Splits full nodes on insertion, refills or merges underfull nodes
+ * on removal.
+ */
+#define	BTREE_GENERATE(name, type, cmp)					\
+	BTREE_GENERATE_INTERNAL(name, type, cmp,)
+#define	BTREE_GENERATE_STATIC(name, type, cmp)				\
+	BTREE_GENERATE_INTERNAL(name, type, cmp, __unused static)
+#define BTREE_GENERATE_INTERNAL(name, type, cmp, attr)			\
+attr struct name##_BTREE_NODE *						\
+name##_BTREE_ALLOC(int leaf)						\
+{									\
+	void *ptr;							\
+	struct name##_BTREE_NODE *node;					\
+	if (posix_memalign(&ptr, BTREE_CACHELINE,			\
+	    sizeof(struct name##_BTREE_NODE)) != 0)			\
+		return (NULL);						\
+	node = (struct name##_BTREE_NODE *)ptr;				\
+	node->btn_parent = node->btn_next = node->btn_prev = NULL;	\
+	node->btn_count = 0;						\
+	node->btn_leaf = leaf;						\
+	return (node);							\
+}									\
+									\
+attr void								\
+name##_BTREE_FREE(struct name##_BTREE_NODE *node)			\
+{									\
+	unsigned int i;							\
+	if (!node->btn_leaf) {						\
+		for (i = 0; i <= node->btn_count; i++)			\
+			name##_BTREE_FREE(node->btn_child[i]);		\
+	}								\
+	free(node);							\
+}									\
+									\
+/* Index of the first entry greater than (upper) or equal to elm */	\
+attr unsigned int							\
+name##_BTREE_BOUND(struct name##_BTREE_NODE *node, struct type *elm,	\
+    int upper)								\
+{									\
+	unsigned int lo = 0, hi = node->btn_count, mid;			\
+	int comp;							\
+	while (lo < hi) {						\
+		mid = (lo + hi) / 2;					\
+		comp = (cmp)(elm, &node->btn_elms[mid]);		\
+		if (comp > 0 || (upper && comp == 0))			\
+			lo = mid + 1;					\
+		else							\
+			hi = mid;					\
+	}								\
+	return (lo);							\
+}									\
+									\
+/* Finds the leaf that elm belongs to */				\
+attr struct name##_BTREE_NODE *						\
+name##_BTREE_DESCEND(struct name *head, struct type *elm)		\
+{									\
+	struct name##_BTREE_NODE *node = BTREE_ROOT(head);		\
+	while (node != NULL && !node->btn_leaf)				\
+		node = node->btn_child[name##_BTREE_BOUND(node, elm, 1)];\
+	return (node);							\
+}									\
+									\
+/* Refills or merges node after entries have been removed from it */	\
+attr void								\
+name##_BTREE_REBALANCE(struct name *head, struct name##_BTREE_NODE *node)\
+{									\
+	struct name##_BTREE_NODE *parent, *left, *right, *tmp;		\
+	unsigned int ci, si, i, total, k;				\
+	for (;;) {							\
+		if ((parent = node->btn_parent) == NULL) {		\
+			if (node->btn_count > 0)			\
+				return;					\
+			if (node->btn_leaf)				\
+				BTREE_ROOT(head) = NULL;		\
+			else {						\
+				BTREE_ROOT(head) = node->btn_child[0];	\
+				BTREE_ROOT(head)->btn_parent = NULL;	\
+			}						\
+			free(node);					\
+			return;						\
+		}							\
+		if (node->btn_count >= BTREE_MINFILL(name))		\
+			return;						\
+		for (ci = 0; parent->btn_child[ci] != node; ci++)	\
+			;						\
+		if (ci > 0) {						\
+			si = ci - 1;					\
+			left = parent->btn_child[si];			\
+			right = node;					\
+		} else {						\
+			si = ci;					\
+			left = node;					\
+			right = parent->btn_child[si + 1];		\
+		}							\
+		total = left->btn_count + right->btn_count;		\
+		if (node->btn_leaf && total > name##_BTREE_ORDER) {	\
+			/* Split the elements evenly among the leaves */\
+			k = total / 2;					\
+			if (left->btn_count > k) {			\
+				k = left->btn_count - k;		\
+				memmove(&right->btn_elms[k], &right->btn_elms[0],\
+				    right->btn_count * sizeof(struct type));\
+				memcpy(&right->btn_elms[0],		\
+				    &left->btn_elms[left->btn_count - k],\
+				    k * sizeof(struct type));		\
+				left->btn_count -= k;			\
+				right->btn_count += k;			\
+			} else {					\
+				k = k - left->btn_count;		\
+				memcpy(&left->btn_elms[left->btn_count],\
+				    &right->btn_elms[0], k * sizeof(struct type));\
+				memmove(&right->btn_elms[0], &right->btn_elms[k],\
+				    (right->btn_count - k) * sizeof(struct type));\
+				left->btn_count += k;			\
+				right->btn_count -= k;			\
+			}						\
+			parent->btn_elms[si] = right->btn_elms[0];	\
+			return;						\
+		}							\
+		if (!node->btn_leaf && total >= name##_BTREE_ORDER) {	\
+			/* Rotate keys through the parent */		\
+			while (left->btn_count < BTREE_MINFILL(name)) {	\
+				left->btn_elms[left->btn_count] =	\
+				    parent->btn_elms[si];		\
+				tmp = right->btn_child[0];		\
+				left->btn_child[++left->btn_count] = tmp;\
+				tmp->btn_parent = left;			\
+				parent->btn_elms[si] = right->btn_elms[0];\
+				memmove(&right->btn_elms[0], &right->btn_elms[1],\
+				    (right->btn_count - 1) * sizeof(struct type));\
+				memmove(&right->btn_child[0], &right->btn_child[1],\
+				    right->btn_count * sizeof(tmp));	\
+				right->btn_count--;			\
+			}						\
+			while (right->btn_count < BTREE_MINFILL(name)) {\
+				memmove(&right->btn_elms[1], &right->btn_elms[0],\
+				    right->btn_count * sizeof(struct type));\
+				memmove(&right->btn_child[1], &right->btn_child[0],\
+				    (right->btn_count + 1) * sizeof(tmp));\
+				right->btn_elms[0] = parent->btn_elms[si];\
+				tmp = left->btn_child[left->btn_count];	\
+				right->btn_child[0] = tmp;		\
+				tmp->btn_parent = right;		\
+				right->btn_count++;			\
+				parent->btn_elms[si] =			\
+				    left->btn_elms[--left->btn_count];	\
+			}						\
+			return;						\
+		}							\
+		/* Merge right into left and drop the separator */	\
+		if (node->btn_leaf) {					\
+			memcpy(&left->btn_elms[left->btn_count],	\
+			    &right->btn_elms[0],			\
+			    right->btn_count * sizeof(struct type));	\
+			left->btn_count += right->btn_count;		\
+			if ((left->btn_next = right->btn_next) != NULL)	\
+				left->btn_next->btn_prev = left;	\
+		} else {						\
+			left->btn_elms[left->btn_count] = parent->btn_elms[si];\
+			memcpy(&left->btn_elms[left->btn_count + 1],	\
+			    &right->btn_elms[0],			\
+			    right->btn_count * sizeof(struct type));	\
+			for (i = 0; i <= right->btn_count; i++) {	\
+				tmp = right->btn_child[i];		\
+				left->btn_child[left->btn_count + 1 + i] = tmp;\
+				tmp->btn_parent = left;			\
+			}						\
+			left->btn_count += right->btn_count + 1;	\
+		}							\
+		memmove(&parent->btn_elms[si], &parent->btn_elms[si + 1],\
+		    (parent->btn_count - si - 1) * sizeof(struct type));\
+		memmove(&parent->btn_child[si + 1], &parent->btn_child[si + 2],\
+		    (parent->btn_count - si - 1) * sizeof(tmp));	\
+		parent->btn_count--;					\
+		free(right);						\
+		node = parent;						\
+	}								\
+}									\
+									\
+/* Inserts a copy of elm, returns the element with the same key if	\
+ * there is one, elm itself if a node could not be allocated, NULL	\
+ * otherwise.								\
+ */									\
+attr struct type *							\
+name##_BTREE_INSERT(struct name *head, struct type *elm)		\
+{									\
+	struct name##_BTREE_NODE *node, *right, *parent, *spare[64], *tmp;\
+	struct name##_BTREE_NODE *child[name##_BTREE_ORDER + 2];	\
+	struct type elms[name##_BTREE_ORDER + 1], sep;			\
+	unsigned int i, n, mid, nspare = 0;				\
+	if ((node = name##_BTREE_DESCEND(head, elm)) == NULL) {		\
+		if ((node = name##_BTREE_ALLOC(1)) == NULL)		\
+			return (elm);					\
+		node->btn_elms[node->btn_count++] = *elm;		\
+		BTREE_ROOT(head) = node;				\
+		BTREE_COUNT(head)++;					\
+		return (NULL);						\
+	}								\
+	i = name##_BTREE_BOUND(node, elm, 0);				\
+	if (i < node->btn_count && (cmp)(elm, &node->btn_elms[i]) == 0)	\
+		return (&node->btn_elms[i]);				\
+	/* Allocate every node a split could need before touching the tree */\
+	for (tmp = node; tmp != NULL &&					\
+	    tmp->btn_count == name##_BTREE_ORDER; tmp = tmp->btn_parent) {\
+		if ((spare[nspare++] = name##_BTREE_ALLOC(1)) == NULL ||\
+		    (tmp->btn_parent == NULL &&				\
+		    (spare[nspare++] = name##_BTREE_ALLOC(0)) == NULL)) {\
+			while (nspare > 0)				\
+				free(spare[--nspare]);			\
+			return (elm);					\
+		}							\
+	}								\
+	BTREE_COUNT(head)++;						\
+	if (node->btn_count < name##_BTREE_ORDER) {			\
+		memmove(&node->btn_elms[i + 1], &node->btn_elms[i],	\
+		    (node->btn_count - i) * sizeof(struct type));	\
+		node->btn_elms[i] = *elm;				\
+		node->btn_count++;					\
+		return (NULL);						\
+	}								\
+	/* Split the leaf, the upper half moves to a new right sibling */\
+	n = name##_BTREE_ORDER + 1;					\
+	memcpy(&elms[0], &node->btn_elms[0], i * sizeof(struct type));	\
+	elms[i] = *elm;							\
+	memcpy(&elms[i + 1], &node->btn_elms[i],			\
+	    (n - 1 - i) * sizeof(struct type));				\
+	mid = n / 2;							\
+	right = spare[--nspare];					\
+	right->btn_leaf = 1;						\
+	memcpy(&node->btn_elms[0], &elms[0], mid * sizeof(struct type));\
+	memcpy(&right->btn_elms[0], &elms[mid],				\
+	    (n - mid) * sizeof(struct type));				\
+	node->btn_count = mid;						\
+	right->btn_count = n - mid;					\
+	if ((right->btn_next = node->btn_next) != NULL)			\
+		right->btn_next->btn_prev = right;			\
+	right->btn_prev = node;						\
+	node->btn_next = right;						\
+	sep = right->btn_elms[0];					\
+	/* Push the separator up, splitting full inner nodes on the way */\
+	for (;;) {							\
+		if ((parent = node->btn_parent) == NULL) {		\
+			parent = spare[--nspare];			\
+			parent->btn_leaf = 0;				\
+			parent->btn_elms[0] = sep;			\
+			parent->btn_child[0] = node;			\
+			parent->btn_child[1] = right;			\
+			parent->btn_count = 1;				\
+			node->btn_parent = right->btn_parent = parent;	\
+			BTREE_ROOT(head) = parent;			\
+			return (NULL);					\
+		}							\
+		for (i = 0; parent->btn_child[i] != node; i++)		\
+			;						\
+		right->btn_parent = parent;				\
+		if (parent->btn_count < name##_BTREE_ORDER) {		\
+			memmove(&parent->btn_elms[i + 1], &parent->btn_elms[i],\
+			    (parent->btn_count - i) * sizeof(struct type));\
+			memmove(&parent->btn_child[i + 2], &parent->btn_child[i + 1],\
+			    (parent->btn_count - i) * sizeof(tmp));	\
+			parent->btn_elms[i] = sep;			\
+			parent->btn_child[i + 1] = right;		\
+			parent->btn_count++;				\
+			return (NULL);					\
+		}							\
+		memcpy(&elms[0], &parent->btn_elms[0], i * sizeof(struct type));\
+		elms[i] = sep;						\
+		memcpy(&elms[i + 1], &parent->btn_elms[i],		\
+		    (n - 1 - i) * sizeof(struct type));			\
+		memcpy(&child[0], &parent->btn_child[0], (i + 1) * sizeof(tmp));\
+		child[i + 1] = right;					\
+		memcpy(&child[i + 2], &parent->btn_child[i + 1],	\
+		    (n - 1 - i) * sizeof(tmp));				\
+		node = parent;						\
+		right = spare[--nspare];				\
+		right->btn_leaf = 0;					\
+		mid = n / 2;						\
+		memcpy(&node->btn_elms[0], &elms[0], mid * sizeof(struct type));\
+		memcpy(&node->btn_child[0], &child[0], (mid + 1) * sizeof(tmp));\
+		node->btn_count = mid;					\
+		memcpy(&right->btn_elms[0], &elms[mid + 1],		\
+		    (n - mid - 1) * sizeof(struct type));		\
+		for (i = 0; i < n - mid; i++) {				\
+			right->btn_child[i] = child[mid + 1 + i];	\
+			right->btn_child[i]->btn_parent = right;	\
+		}							\
+		right->btn_count = n - mid - 1;				\
+		sep = elms[mid];					\
+	}								\
+}									\
+									\
+/* Removes the element with the same key as elm and copies it to elm,	\
+ * returns elm or NULL if there is no such element.			\
+ */									\
+attr struct type *							\
+name##_BTREE_REMOVE(struct name *head, struct type *elm)		\
+{									\
+	struct name##_BTREE_NODE *node;					\
+	unsigned int i;							\
+	if ((node = name##_BTREE_DESCEND(head, elm)) == NULL)		\
+		return (NULL);						\
+	i = name##_BTREE_BOUND(node, elm, 0);				\
+	if (i == node->btn_count || (cmp)(elm, &node->btn_elms[i]) != 0)\
+		return (NULL);						\
+	*elm = node->btn_elms[i];					\
+	memmove(&node->btn_elms[i], &node->btn_elms[i + 1],		\
+	    (node->btn_count - i - 1) * sizeof(struct type));		\
+	node->btn_count--;						\
+	BTREE_COUNT(head)--;						\
+	name##_BTREE_REBALANCE(head, node);				\
+	return (elm);							\
+}									\
+									\
+/* Removes all elements from lo up to but excluding hi, returns the	\
+ * number of removed elements.						\
+ */									\
+attr size_t								\
+name##_BTREE_REMOVE_RANGE(struct name *head, struct type *lo,		\
+    struct type *hi)							\
+{									\
+	struct name##_BTREE_NODE *node;					\
+	struct name##_BTREE_ITER it;					\
+	struct type *tmp;						\
+	unsigned int i, j;						\
+	size_t removed = 0;						\
+	while ((tmp = name##_BTREE_LOWER_BOUND(head, lo, &it)) != NULL &&\
+	    (cmp)(tmp, hi) < 0) {					\
+		node = it.bti_node;					\
+		i = it.bti_idx;						\
+		for (j = i + 1; j < node->btn_count &&			\
+		    (cmp)(&node->btn_elms[j], hi) < 0; j++)		\
+			;						\
+		memmove(&node->btn_elms[i], &node->btn_elms[j],		\
+		    (node->btn_count - j) * sizeof(struct type));	\
+		node->btn_count -= j - i;				\
+		BTREE_COUNT(head) -= j - i;				\
+		removed += j - i;					\
+		name##_BTREE_REBALANCE(head, node);			\
+	}								\
+	return (removed);						\
+}									\
+									\
+/* Finds the element with the same key as elm */			\
+attr struct type *							\
+name##_BTREE_FIND(struct name *head, struct type *elm)			\
+{									\
+	struct name##_BTREE_NODE *node;					\
+	unsigned int i;							\
+	if ((node = name##_BTREE_DESCEND(head, elm)) == NULL)		\
+		return (NULL);						\
+	i = name##_BTREE_BOUND(node, elm, 0);				\
+	if (i < node->btn_count && (cmp)(elm, &node->btn_elms[i]) == 0)	\
+		return (&node->btn_elms[i]);				\
+	return (NULL);							\
+}									\
+									\
+/* Finds the first element greater than or equal to the search key */	\
+attr struct type *							\
+name##_BTREE_LOWER_BOUND(struct name *head, struct type *elm,		\
+    struct name##_BTREE_ITER *it)					\
+{									\
+	struct name##_BTREE_NODE *node;					\
+	unsigned int i;							\
+	if ((node = name##_BTREE_DESCEND(head, elm)) == NULL) {		\
+		it->bti_node = NULL;					\
+		return (NULL);						\
+	}								\
+	i = name##_BTREE_BOUND(node, elm, 0);				\
+	if (i == node->btn_count) {					\
+		node = node->btn_next;					\
+		i = 0;							\
+	}								\
+	it->bti_node = node;						\
+	it->bti_idx = i;						\
+	return (node == NULL ? NULL : &node->btn_elms[i]);		\
+}									\
+									\
+attr struct type *							\
+name##_BTREE_FIRST(struct name *head, struct name##_BTREE_ITER *it)	\
+{									\
+	struct name##_BTREE_NODE *node = BTREE_ROOT(head);		\
+	while (node != NULL && !node->btn_leaf)				\
+		node = node->btn_child[0];				\
+	it->bti_node = node;						\
+	it->bti_idx = 0;						\
+	return (node == NULL ? NULL : &node->btn_elms[0]);		\
+}									\
+									\
+attr struct type *							\
+name##_BTREE_LAST(struct name *head, struct name##_BTREE_ITER *it)	\
+{									\
+	struct name##_BTREE_NODE *node = BTREE_ROOT(head);		\
+	while (node != NULL && !node->btn_leaf)				\
+		node = node->btn_child[node->btn_count];		\
+	it->bti_node = node;						\
+	if (node == NULL)						\
+		return (NULL);						\
+	it->bti_idx = node->btn_count - 1;				\
+	return (&node->btn_elms[it->bti_idx]);				\
+}									\
+									\
+attr struct type *							\
+name##_BTREE_NEXT(struct name##_BTREE_ITER *it)				\
+{									\
+	if (++it->bti_idx == it->bti_node->btn_count) {			\
+		it->bti_node = it->bti_node->btn_next;			\
+		it->bti_idx = 0;					\
+	}								\
+	if (it->bti_node == NULL)					\
+		return (NULL);						\
+	return (&it->bti_node->btn_elms[it->bti_idx]);			\
+}									\
+									\
+attr struct type *							\
+name##_BTREE_PREV(struct name##_BTREE_ITER *it)				\
+{									\
+	if (it->bti_idx-- == 0) {					\
+		it->bti_node = it->bti_node->btn_prev;			\
+		if (it->bti_node == NULL)				\
+			return (NULL);					\
+		it->bti_idx = it->bti_node->btn_count - 1;		\
+	}								\
+	return (&it->bti_node->btn_elms[it->bti_idx]);			\
+}									\
+									\
+/* Releases all nodes of the tree */					\
+attr void								\
+name##_BTREE_DESTROY(struct name *head)					\
+{									\
+	if (BTREE_ROOT(head) != NULL)					\
+		name##_BTREE_FREE(BTREE_ROOT(head));			\
+	BTREE_INIT(head);						\
+}
+
+#define BTREE_INSERT(name, x, y)	name##_BTREE_INSERT(x, y)
+#define BTREE_REMOVE(name, x, y)	name##_BTREE_REMOVE(x, y)
+#define BTREE_REMOVE_RANGE(name, x, lo, hi)				\
+	name##_BTREE_REMOVE_RANGE(x, lo, hi)
+#define BTREE_FIND(name, x, y)		name##_BTREE_FIND(x, y)
+#define BTREE_LOWER_BOUND(name, x, y, it)				\
+	name##_BTREE_LOWER_BOUND(x, y, it)
+#define BTREE_FIRST(name, x, it)	name##_BTREE_FIRST(x, it)
+#define BTREE_LAST(name, x, it)		name##_BTREE_LAST(x, it)
+#define BTREE_NEXT(name, it)		name##_BTREE_NEXT(it)
+#define BTREE_PREV(name, it)		name##_BTREE_PREV(it)
+#define BTREE_DESTROY(name, x)		name##_BTREE_DESTROY(x)
+
+#define BTREE_FOREACH(x, name, head, it)				\
+	for ((x) = BTREE_FIRST(name, head, it);				\
+	     (x) != NULL;						\
+	     (x) = name##_BTREE_NEXT(it))
+
+#define BTREE_FOREACH_FROM(x, name, head, y, it)			\
+	for ((x) = BTREE_LOWER_BOUND(name, head, y, it);		\
+	     (x) != NULL;						\
+	     (x) = name##_BTREE_NEXT(it))
+
+#define BTREE_FOREACH_REVERSE(x, name, head, it)			\
+	for ((x) = BTREE_LAST(name, head, it);				\
+	     (x) != NULL;						\
+	     (x) = name##_BTREE_PREV(it))
+
 #endif	/* _SYS_TREE_H_ */
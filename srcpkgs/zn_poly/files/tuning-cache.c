@@ -0,0 +1,91 @@
+
+/*
+   Runtime tuning overrides.
+
+   The thresholds above were measured once, on a single machine. If the
+   file named by $ZN_POLY_TUNING_CACHE (default /var/cache/zn_poly/tuning)
+   exists, the values written there by zn_poly-tune replace them when the
+   library is loaded. Every line of that file is one of
+
+      kara <n>
+      mulmid_fallback <n>
+      bits <b> <the 11 thresholds of tuning_info_t, in order>
+
+   where "max" stands for SIZE_MAX. Malformed lines are ignored.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define ZNP_TUNING_CACHE "/var/cache/zn_poly/tuning"
+#define ZNP_TUNING_FIELDS 11
+
+static int
+ZNP_tuning_cache_value (char** s, size_t* res)
+{
+   char* end;
+   unsigned long long x;
+
+   *s += strspn (*s, " \t");
+   if (strncmp (*s, "max", 3) == 0)
+   {
+      *s += 3;
+      *res = SIZE_MAX;
+      return 1;
+   }
+   if (**s < '0' || **s > '9')
+      return 0;
+   x = strtoull (*s, &end, 10);
+   *s = end;
+   *res = (x > SIZE_MAX) ? SIZE_MAX : (size_t) x;
+   return 1;
+}
+
+__attribute__ ((constructor)) static void
+ZNP_tuning_cache_load (void)
+{
+   const char* path = getenv ("ZN_POLY_TUNING_CACHE");
+   size_t v[ZNP_TUNING_FIELDS], bits;
+   char line[512], *s;
+   unsigned i;
+   FILE* f;
+
+   if (path == NULL || *path == '\0')
+      path = ZNP_TUNING_CACHE;
+   if ((f = fopen (path, "r")) == NULL)
+      return;
+
+   while (fgets (line, sizeof (line), f) != NULL)
+   {
+      s = line;
+      if (strncmp (s, "kara ", 5) == 0)
+      {
+         s += 5;
+         if (ZNP_tuning_cache_value (&s, &v[0]))
+            ZNP_mpn_smp_kara_thresh = v[0];
+      }
+      else if (strncmp (s, "mulmid_fallback ", 16) == 0)
+      {
+         s += 16;
+         if (ZNP_tuning_cache_value (&s, &v[0]))
+            ZNP_mpn_mulmid_fallback_thresh = v[0];
+      }
+      else if (strncmp (s, "bits ", 5) == 0)
+      {
+         s += 5;
+         if (!ZNP_tuning_cache_value (&s, &bits) ||
+             bits >= sizeof (tuning_info) / sizeof (tuning_info[0]))
+            continue;
+         for (i = 0; i < ZNP_TUNING_FIELDS; i++)
+            if (!ZNP_tuning_cache_value (&s, &v[i]))
+               break;
+         if (i < ZNP_TUNING_FIELDS)
+            continue;
+         tuning_info[bits] = (tuning_info_t) {
+            v[0], v[1], v[2], v[3], v[4], v[5], v[6], v[7], v[8], v[9], v[10]
+         };
+      }
+   }
+   fclose (f);
+}